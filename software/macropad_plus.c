@@ -22,7 +22,7 @@
 // Compilation Instructions:
 // -------------------------
 // - Chip:  CH551, CH552 or CH554
-// - Clock: 16 MHz internal
+// - Clock: 16 MHz internal (boot clock, scaled at runtime, see src/config.h)
 // - Adjust the firmware parameters in src/config.h if necessary.
 // - Customize the macro functions in the corresponding section below.
 // - Make sure SDCC toolchain and Python3 with PyUSB is installed.
@@ -35,11 +35,34 @@
 // Operating Instructions:
 // -----------------------
 // - Connect the board via USB to your PC. It should be detected as a HID device with
-//   keyboard, mouse and joystick interface.
+//   keyboard, mouse and gamepad interface.
 // - Press a macro key or turn the knob and see what happens.
+// - When the host goes to sleep, the NeoPixels are switched off and the MacroPad
+//   sleeps as well. Key 3 and the rotary encoder can wake up the host again.
+// - Run 'python3 tools/diag.py' to read the diagnostics (e.g. oscillator deviation).
+// - With MKEY_LAYER in src/config.h, holding the encoder switch turns the keys into
+//   mouse keys (see MKEY_map), tapping it toggles drag lock.
+// - With JOY_MODE in src/config.h, keys and knob drive the gamepad (see JOY_map):
+//   16 buttons, hat switch and a slider axis set by the knob position.
+// - With MIDI_ENABLE in src/config.h, the MacroPad is also a USB MIDI device: keys
+//   send notes, the knob a control change (see MIDI_notes), and control changes
+//   from the host set the NeoPixel colors.
+// - With RAW_ENABLE in src/config.h, host applications can set the NeoPixels and
+//   read the input state through a 64-byte raw HID interface (see RAW_CMD_xxx),
+//   e.g. with 'python3 tools/rawhid.py'. With RAW_WINUSB it is a driverless vendor
+//   interface instead (WinUSB, WebUSB).
+// - With ENC_DIAL in src/config.h, the knob is a radial controller (Surface Dial
+//   style) with the encoder switch as its button.
+// - With ENC_SCROLL in src/config.h, the knob scrolls like a high-resolution mouse
+//   wheel instead of typing F16/F18.
+// - With TRACE_ENABLE in src/config.h, 'python3 tools/trace.py' prints a timeline of
+//   the latest pin transitions, debounce decisions, encoder steps and reports.
 // - To enter bootloader hold down rotary encoder switch while connecting the 
 //   MacroPad to USB. All NeoPixels will light up white as long as the device is in 
 //   bootloader mode (about 10 seconds).
+// - Without touching the device, 'python3 tools/chprog.py -r firmware.bin' sends
+//   the bootloader request (feature report 0x15, see src/diag.h) and flashes the
+//   firmware as soon as the bootloader shows up.
 
 
 // ===================================================================================
@@ -51,6 +74,17 @@
 #include "src/system.h"                     // system functions
 #include "src/delay.h"                      // delay functions
 #include "src/neo.h"                        // NeoPixel functions
+#include "src/tick.h"                       // 1ms timebase (USB SOF)
+#include "src/cal.h"                        // oscillator calibration
+#include "src/lat.h"                        // input-to-report latency
+#include "src/prof.h"                       // section profiler
+#include "src/trace.h"                      // input event trace
+#include "src/tele.h"                       // USB transport telemetry
+#include "src/diag.h"                       // diagnostics, bootloader request
+#include "src/task.h"                       // cooperative task scheduler
+#include "src/mkey.h"                       // mouse keys
+#include "src/midi.h"                       // USB MIDI functions
+#include "src/raw.h"                        // USB raw HID functions
 #include "src/usb_composite.h"              // USB HID composite functions
 
 // Prototypes for used interrupts
@@ -59,13 +93,19 @@ void USB_ISR(void) __interrupt(INT_NO_USB) {
   USB_interrupt();
 }
 
+void TICK_interrupt(void);
+void TMR0_ISR(void) __interrupt(INT_NO_TMR0) {
+  TICK_interrupt();
+}
+
 #pragma disable_warning 110                 // Keep calm, EVELYN!
 
 // ===================================================================================
 // Macro Functions which associate Actions with Events (Customize your MacroPad here!)
 // ===================================================================================
 /*
-  The list of available USB HID functions can be found in src/usb_composite.h
+  The list of available USB HID functions can be found in src/usb_composite.h,
+  the mouse keys (held keys move the pointer) in src/mkey.h.
   The keys are enumerated the following way:
                   -----
   +---+---+---+ /       \
@@ -136,6 +176,47 @@ inline void ENC_CW_ACTION() {
   KBD_type(KBD_KEY_F18);                             // press & release F18 key
 }
 
+// Mouse layer (MKEY_LAYER in config.h): hold encoder switch -> mouse keys
+// ---------------------------------------------
+// While the encoder switch is held, keys 1-3 move the pointer in the directions
+// below (MKEY_xxx, see src/mkey.h) and the knob scrolls. Tapping the switch alone
+// toggles drag lock.
+__code uint8_t MKEY_map[3] = {MKEY_LEFT, MKEY_DOWN, MKEY_RIGHT};  // key 1..3
+
+// Gamepad mode (JOY_MODE in config.h): keys -> gamepad
+// ---------------------------------------------
+// Each input is mapped to a gamepad button (1..16) or a hat switch direction
+// (JOY_MAP_HAT | JOY_HAT_xxx), JOY_MAP_AXIS lets the encoder move the slider axis.
+// Inputs mapped to 0 keep their macro functions above.
+#define JOY_MAP_HAT       0x80
+#define JOY_MAP_AXIS      0x40
+__code uint8_t JOY_map[5] = {
+  1, 2, 3,                                  // key 1..3
+  JOY_MAP_AXIS,                             // encoder
+  4                                         // encoder switch
+};
+
+// MIDI (MIDI_ENABLE in config.h): keys -> notes, encoder -> control change
+// ---------------------------------------------
+// Each input sends Note On/Off for the note below (0 = keep the macro function),
+// the encoder sends control change MIDI_ENC_CC (see config.h).
+__code uint8_t MIDI_notes[5] = {
+  60, 62, 64,                               // key 1..3 (C4, D4, E4)
+  1,                                        // encoder (not 0: control change)
+  67                                        // encoder switch (G4)
+};
+
+// Raw HID (RAW_ENABLE in config.h): 64-byte packets, byte 0 is the command
+// ---------------------------------------------
+// Host -> MacroPad:
+//   RAW_CMD_LEDS   red, green, blue of each NeoPixel (shown with the next frame)
+//   RAW_CMD_STATE  request state packet
+// MacroPad -> host (on every input change and on request):
+//   RAW_CMD_STATE  inputs (IN_xxx bits), encoder position in half detents (16-bit),
+//                  time in ms (16-bit), little-endian
+#define RAW_CMD_LEDS      0x01
+#define RAW_CMD_STATE     0x02
+
 // ===================================================================================
 // NeoPixel Configuration
 // ===================================================================================
@@ -151,19 +232,468 @@ inline void ENC_CW_ACTION() {
 #define NEO_KEY5          128       // blue
 #define NEO_KEY6          160       // magenta
 
+// ===================================================================================
+// Input Scanning
+// ===================================================================================
+
+// Input bits (1 = active)
+#define IN_KEY1           0x01      // key 1
+#define IN_KEY2           0x02      // key 2
+#define IN_KEY3           0x04      // key 3
+#define IN_ENC_A          0x08      // rotary encoder A
+#define IN_ENC_SW         0x10      // rotary encoder switch
+#define IN_COUNT          5         // number of inputs
+
+// Lock-out time after an accepted edge for each input in ms
+__code uint8_t IN_debounce[IN_COUNT] = {
+  KEY_DEBOUNCE, KEY_DEBOUNCE, KEY_DEBOUNCE, ENC_DEBOUNCE, KEY_DEBOUNCE
+};
+
+// Read all inputs (active low) into one byte
+uint8_t IN_read(void) {
+  uint8_t input = 0;
+  if(!PIN_read(PIN_KEY1))   input |= IN_KEY1;
+  if(!PIN_read(PIN_KEY2))   input |= IN_KEY2;
+  if(!PIN_read(PIN_KEY3))   input |= IN_KEY3;
+  if(!PIN_read(PIN_ENC_A))  input |= IN_ENC_A;
+  if(!PIN_read(PIN_ENC_SW)) input |= IN_ENC_SW;
+  return input;
+}
+
+// Input state
+__idata uint8_t IN_state = 0;               // debounced input state (1 = active)
+__idata uint8_t IN_lock[IN_COUNT];          // debounce lock-out timers in ms
+
+// ===================================================================================
+// Tasks
+// ===================================================================================
+
+// Task IDs (TASK_COUNT in config.h)
+#define TASK_SCAN         0         // input scan and actions, every 1ms
+#define TASK_CAL          1         // oscillator calibration, every 1ms
+#define TASK_SLEEP        2         // USB suspend check, every 1ms
+#define TASK_LED          3         // NeoPixel frame, every NEO_FRAME_TIME ms
+#define TASK_IDLE         4         // clock scaling, once CLK_IDLE_TIME after input
+#define TASK_REPORT       5         // mouse keys, mouse and gamepad reports, every 1ms
+#define TASK_MACRO        6         // macro step: next queued report, every 1ms
+
+__bit suspended = 0;                        // device in USB suspend state
+uint8_t wakeWait = 0;                       // ms waited for resume after remote wakeup
+
+// Slow down clock if there was no input for a while
+void IDLE_task(void) {
+  CLK_set(CLK_IDLE);                        // slow down
+}
+
+#ifdef MKEY_LAYER
+__bit MKEY_layerUsed = 0;                   // layer used since switch was pressed
+uint8_t MKEY_layerKeys = 0;                 // keys pressed in the layer (IN_KEYx)
+
+// Mouse layer: returns the changes of the inputs which the layer did not take
+uint8_t MKEY_layer(uint8_t changed) {
+  uint8_t i, mask;
+
+  // Keys pressed in the layer are released in the layer, even if it was left
+  for(i=0, mask=IN_KEY1; i<3; i++, mask<<=1) {
+    if((changed & MKEY_layerKeys & mask) && !(IN_state & mask)) {
+      MKEY_release(MKEY_map[i]);
+      MKEY_layerKeys &= ~mask;
+      changed &= ~mask;                     // taken by the layer
+    }
+  }
+
+  if(changed & IN_ENC_SW) {                 // layer switched?
+    changed &= ~IN_ENC_SW;
+    if(IN_state & IN_ENC_SW) MKEY_layerUsed = 0;
+    else {
+      MKEY_release(MKEY_ALL);               // stop all motion
+      if(!MKEY_layerUsed) MKEY_dragLock();  // tapped alone: toggle drag lock
+      return changed;
+    }
+  }
+  if(!(IN_state & IN_ENC_SW)) return changed; // layer not active
+
+  for(i=0, mask=IN_KEY1; i<3; i++, mask<<=1) {
+    if(changed & IN_state & mask) {         // key pressed in the layer?
+      MKEY_press(MKEY_map[i]);
+      MKEY_layerKeys |= mask;
+      MKEY_layerUsed = 1;
+      changed &= ~mask;                     // taken by the layer
+    }
+  }
+  if(changed & IN_ENC_A) {                  // knob turned?
+    changed &= ~IN_ENC_A;                   // both edges taken by the layer
+    if(IN_state & IN_ENC_A) {               // one step per detent
+      if(PIN_read(PIN_ENC_B)) MOUSE_wheel_down(); // clockwise
+      else                    MOUSE_wheel_up();   // counter-clockwise
+      MKEY_layerUsed = 1;
+    }
+  }
+  return changed;                           // released keys pressed before the layer
+}
+#endif
+
+#ifdef MIDI_ENABLE
+#ifdef MIDI_ENC_ABSOLUTE
+uint8_t MIDI_encValue = 64;                 // absolute encoder value (0..127)
+#endif
+
+// MIDI: inputs send notes and control changes, returns the changes of the inputs
+// which are not mapped
+uint8_t MIDI_input(uint8_t changed) {
+  uint8_t i, mask, note;
+
+  for(i=0, mask=1; i<IN_COUNT; i++, mask<<=1) {
+    note = MIDI_notes[i];
+    if(!(changed & mask) || !note) continue;  // unchanged or not mapped
+    changed &= ~mask;                       // taken by MIDI
+    if(mask == IN_ENC_A) {
+      if(!(IN_state & IN_ENC_A)) continue;  // one step per detent
+      if(PIN_read(PIN_ENC_B)) {             // clockwise ?
+        TRACE_add(TRACE_ENC, TRACE_CW);
+        #ifdef MIDI_ENC_ABSOLUTE
+        if(MIDI_encValue <= 127 - MIDI_ENC_STEP) MIDI_encValue += MIDI_ENC_STEP;
+        else MIDI_encValue = 127;
+        MIDI_control(MIDI_ENC_CC, MIDI_encValue);
+        #else
+        MIDI_control(MIDI_ENC_CC, MIDI_ENC_STEP);
+        #endif
+      }
+      else {                                // counter-clockwise ?
+        TRACE_add(TRACE_ENC, TRACE_CCW);
+        #ifdef MIDI_ENC_ABSOLUTE
+        if(MIDI_encValue >= MIDI_ENC_STEP) MIDI_encValue -= MIDI_ENC_STEP;
+        else MIDI_encValue = 0;
+        MIDI_control(MIDI_ENC_CC, MIDI_encValue);
+        #else
+        MIDI_control(MIDI_ENC_CC, 128 - MIDI_ENC_STEP);
+        #endif
+      }
+    }
+    else if(IN_state & mask) MIDI_noteOn(note, MIDI_VELOCITY);
+    else                     MIDI_noteOff(note);
+  }
+  return changed;
+}
+
+// MIDI: send queued events, control changes from host set the NeoPixels
+void MIDI_task(void) {
+  __xdata uint8_t *event;
+  uint8_t pixel;
+
+  MIDI_flush();                             // all queued events in one packet
+  while((event = MIDI_read())) {
+    if((event[0] & 0x0F) != MIDI_CIN_CONTROL) continue;
+    if((event[1] & 0x0F) != MIDI_CHANNEL) continue;
+    pixel = event[2] - MIDI_LED_CC;
+    if(pixel >= NEO_COUNT) continue;        // other controller
+    if(event[3]) NEO_writeHue(pixel, (uint8_t)((event[3] - 1) * 3 / 2), NEO_BRIGHT_KEYS);
+    else         NEO_clearPixel(pixel);     // value 0: pixel off
+  }
+}
+#endif
+
+#ifdef RAW_ENABLE
+int16_t RAW_encPos = 0;                     // encoder position in half detents
+__bit   RAW_pending = 0;                    // state packet to send
+
+// Raw HID: count encoder steps, every input change is sent to the host
+void RAW_input(uint8_t changed) {
+  if(changed & IN_ENC_A) {                  // each edge of A is half a detent
+    if(!PIN_read(PIN_ENC_B) == !(IN_state & IN_ENC_A)) RAW_encPos++;  // clockwise ?
+    else                                               RAW_encPos--;
+  }
+  RAW_pending = 1;
+}
+
+// Raw HID: NeoPixel frames and state requests from host, state packets to host
+void RAW_task(void) {
+  __xdata uint8_t *buf;
+  uint16_t ms;
+  uint8_t i;
+
+  if((buf = RAW_read())) {
+    if(buf[0] == RAW_CMD_LEDS) {
+      for(i=0; i<NEO_COUNT; i++) NEO_writeColor(i, buf[3*i+1], buf[3*i+2], buf[3*i+3]);
+    }
+    else if(buf[0] == RAW_CMD_STATE) RAW_pending = 1;
+    RAW_release();                          // host can send the next packet
+  }
+  if(RAW_pending && (buf = RAW_buffer())) { // last packet fetched by host?
+    ms = TICK_millis();
+    buf[0] = RAW_CMD_STATE;
+    buf[1] = IN_state;
+    buf[2] = (uint8_t)RAW_encPos;
+    buf[3] = (uint16_t)RAW_encPos >> 8;
+    buf[4] = (uint8_t)ms;
+    buf[5] = ms >> 8;
+    for(i=6; i<RAW_SIZE; i++) buf[i] = 0;
+    RAW_send();
+    RAW_pending = 0;
+  }
+}
+#endif
+
+#ifdef JOY_MODE
+int16_t JOY_pos = 0;                        // accumulated encoder position (slider)
+
+// Gamepad mode: inputs drive the gamepad through JOY_map, returns the changes of
+// the inputs which are not mapped
+uint8_t JOY_input(uint8_t changed) {
+  uint8_t i, mask, code;
+
+  for(i=0, mask=1; i<IN_COUNT; i++, mask<<=1) {
+    code = JOY_map[i];
+    if(!(changed & mask) || !code) continue;  // unchanged or not mapped
+    changed &= ~mask;                       // taken by the gamepad
+    if(code & JOY_MAP_AXIS) {               // each edge of A is half a detent
+      if(!PIN_read(PIN_ENC_B) == !(IN_state & IN_ENC_A)) {  // clockwise ?
+        TRACE_add(TRACE_ENC, TRACE_CW);
+        JOY_pos = (JOY_pos > 32767 - JOY_AXIS_STEP) ? 32767 : JOY_pos + JOY_AXIS_STEP;
+      }
+      else {                                // counter-clockwise ?
+        TRACE_add(TRACE_ENC, TRACE_CCW);
+        JOY_pos = (JOY_pos < JOY_AXIS_STEP - 32767) ? -32767 : JOY_pos - JOY_AXIS_STEP;
+      }
+      JOY_axis(JOY_pos);                    // sent by the report task
+    }
+    else if(code & JOY_MAP_HAT) {
+      if(IN_state & mask) JOY_hatPress(code & 0x0F);
+      else                JOY_hatRelease(code & 0x0F);
+    }
+    else {
+      if(IN_state & mask) JOY_press(JOY_BUTTON(code));
+      else                JOY_release(JOY_BUTTON(code));
+    }
+  }
+  return changed;
+}
+#endif
+
+// Move pointer with held mouse keys and send the reports which collect changes
+void REPORT_task(void) {
+  MKEY_update();                            // integrate mouse key motion
+  MOUSE_flush();                            // at most one report per frame
+  JOY_flush();                              // gamepad report if changed
+  #ifdef MIDI_ENABLE
+  MIDI_task();                              // MIDI events in and out
+  #endif
+  #ifdef RAW_ENABLE
+  RAW_task();                               // raw HID packets in and out
+  #endif
+  LAT_drop();                               // edge of this tick sent no report?
+}
+
+// Scan and debounce inputs, take actions
+void SCAN_task(void) {
+  uint8_t i, mask, input, changed;
+
+  // Read and debounce inputs
+  // ------------------------
+  PROF_start(PROF_DEBOUNCE);
+  input   = IN_read();                      // read all inputs
+  changed = 0;
+  for(i=0, mask=1; i<IN_COUNT; i++, mask<<=1) {
+    if(IN_lock[i]) IN_lock[i]--;            // still bouncing: ignore input
+    else if((input ^ IN_state) & mask) {    // input changed?
+      changed |= mask;                      // accept edge
+      IN_lock[i] = IN_debounce[i];          // lock input while bouncing
+    }
+  }
+  PROF_stop(PROF_DEBOUNCE);
+  TRACE_scan(input, changed);               // input event trace
+  if(!changed) return;                      // nothing to do
+  IN_state ^= changed;                      // update debounced state
+  PROF_start(PROF_MACRO);
+
+  CLK_set(CLK_ACTIVE);                      // full speed for the actions
+  LAT_edge();                               // start latency measurement
+  TASK_after(TASK_IDLE, IDLE_task, CLK_IDLE_TIME);  // restart idle time
+
+#ifdef RAW_ENABLE
+  RAW_input(changed);                       // state packet to host application
+#endif
+
+#ifdef MKEY_LAYER
+  changed = MKEY_layer(changed);            // mouse layer takes its inputs
+#endif
+
+#ifdef JOY_MODE
+  changed = JOY_input(changed);             // mapped inputs drive the gamepad
+#endif
+
+#ifdef MIDI_ENABLE
+  changed = MIDI_input(changed);            // mapped inputs send MIDI
+#endif
+
+  // Handle key 1
+  // ------------
+  if(changed & IN_KEY1) {                   // key state changed?
+    if(IN_state & IN_KEY1) {                // key was pressed?
+      KEY1_PRESSED();                       // take proper action
+    }
+    else {                                  // key was released?
+      KEY1_RELEASED();                      // take proper action
+    }
+  }
+
+  // Handle key 2
+  // ------------
+  if(changed & IN_KEY2) {                   // key state changed?
+    if(IN_state & IN_KEY2) {                // key was pressed?
+      KEY2_PRESSED();                       // take proper action
+    }
+    else {                                  // key was released?
+      KEY2_RELEASED();                      // take proper action
+    }
+  }
+
+  // Handle key 3
+  // ------------
+  if(changed & IN_KEY3) {                   // key state changed?
+    if(IN_state & IN_KEY3) {                // key was pressed?
+      KEY3_PRESSED();                       // take proper action
+    }
+    else {                                  // key was released?
+      KEY3_RELEASED();                      // take proper action
+    }
+  }
+
+  // Handle rotary encoder
+  // ---------------------
+#if defined(ENC_DIAL)
+  if(changed & IN_ENC_A) {                  // each edge of A is half a detent
+    if(!PIN_read(PIN_ENC_B) == !(IN_state & IN_ENC_A)) {  // clockwise ?
+      TRACE_add(TRACE_ENC, TRACE_CW);
+      DIAL_rotate(DIAL_STEP / 2);           // rotate dial clockwise
+    }
+    else {                                  // counter-clockwise ?
+      TRACE_add(TRACE_ENC, TRACE_CCW);
+      DIAL_rotate(-(DIAL_STEP / 2));        // rotate dial counter-clockwise
+    }
+  }
+#elif defined(ENC_SCROLL)
+  if(changed & IN_ENC_A) {                  // each edge of A is half a detent
+    if(!PIN_read(PIN_ENC_B) == !(IN_state & IN_ENC_A)) {  // clockwise ?
+      TRACE_add(TRACE_ENC, TRACE_CW);
+      MOUSE_wheelHiRes(-(MOUSE_WHEEL_RES / 2)); // scroll down (sent by mouse task)
+    }
+    else {                                  // counter-clockwise ?
+      TRACE_add(TRACE_ENC, TRACE_CCW);
+      MOUSE_wheelHiRes(MOUSE_WHEEL_RES / 2);    // scroll up (sent by mouse task)
+    }
+  }
+#else
+  if(changed & IN_state & IN_ENC_A) {       // encoder started turning?
+    if(PIN_read(PIN_ENC_B)) {               // clockwise ?
+      TRACE_add(TRACE_ENC, TRACE_CW);
+      ENC_CW_ACTION();                      // take proper action
+    }
+    else {                                  // counter-clockwise ?
+      TRACE_add(TRACE_ENC, TRACE_CCW);
+      ENC_CCW_ACTION();                     // take proper action
+    }
+  }
+#endif
+
+  // Handle encoder switch
+  // ---------------------
+  if(changed & IN_ENC_SW) {                 // key state changed?
+    if(IN_state & IN_ENC_SW) {              // key was pressed?
+#ifdef ENC_DIAL
+      DIAL_press();                         // dial button
+#else
+      ENC_SW_PRESSED();                     // take proper action
+#endif
+    }
+    else {                                  // key was released?
+#ifdef ENC_DIAL
+      DIAL_release();                       // dial button
+#else
+      ENC_SW_RELEASED();                    // take proper action
+#endif
+    }
+  }
+  PROF_stop(PROF_MACRO);
+}
+
+// Send pixel buffer to the NeoPixels (not while sleeping)
+void LED_task(void) {
+  if(suspended) return;
+  PROF_start(PROF_NEO);
+  NEO_update();
+  PROF_stop(PROF_NEO);
+}
+
+// Put device to sleep if the host suspended the bus
+void SLEEP_task(void) {
+  uint8_t wake;
+  if(USB_suspendFlag) {                     // host suspended the bus?
+    if(!suspended) {                        // just entered suspend?
+      suspended = 1;                        // set flag
+      NEO_blank();                          // switch off NeoPixels
+    }
+    if(USB_wakeSentFlag) {                  // remote wakeup signaled?
+      if(++wakeWait < USB_WAKE_TIMEOUT) return; // stay awake until the host resumes
+      USB_wakeSentFlag = 0;                 // host did not resume: may signal again
+    }
+    wakeWait = 0;
+    // Only KEY3 (RXD1), encoder B (RXD0) and encoder switch (INT1) can wake
+    // the chip; pins which are already low would wake it up immediately.
+    wake = WAKE_USB;                        // wake-up by bus activity
+    if(PIN_read(PIN_KEY3))   wake |= WAKE_RXD1; // wake-up by key 3
+    if(PIN_read(PIN_ENC_B))  wake |= WAKE_RXD0; // wake-up by encoder turn
+    if(PIN_read(PIN_ENC_SW)) wake |= WAKE_INT;  // wake-up by encoder switch
+    WDT_stop();                             // stop watchdog while sleeping
+    WAKE_enable(wake);                      // set wake-up sources
+    SLEEP_now();                            // sleep until wake-up event
+    WAKE_all_disable();                     // disable wake-up sources
+    WDT_start();                            // restart watchdog
+  }
+  else {
+    suspended = 0;                          // bus active: LED task resumes
+    wakeWait  = 0;
+  }
+}
+
+// Enter bootloader on request of the host: release everything the host may still
+// consider pressed, switch off the NeoPixels and detach from the bus long enough
+// for the host to notice before the bootloader connects
+void BOOT_request(void) {
+  uint8_t i;
+  MKEY_release(MKEY_ALL);                   // stop mouse keys
+  KBD_releaseAll();
+  CON_releaseAll();
+  SYS_release();
+  MOUSE_release(MOUSE_BUTTON_LEFT | MOUSE_BUTTON_RIGHT | MOUSE_BUTTON_MIDDLE);
+  DIAL_release();
+  JOY_release(0xFFFF);
+  JOY_hatRelease(JOY_HAT_UP | JOY_HAT_RIGHT | JOY_HAT_DOWN | JOY_HAT_LEFT);
+  JOY_flush();
+  #ifdef MIDI_ENABLE
+  MIDI_control(123, 0);                     // all notes off
+  MIDI_flush();
+  #endif
+  for(i=20; i && HID_busy(); i--) {         // all reports fetched
+    HID_step();
+    DLY_ms(1);
+  }
+  NEO_clearAll();                           // switch off NeoPixels
+  WDT_stop();                               // bootloader does not feed the watchdog
+  USB_CTRL = 0;                             // detach: pull-up off
+  DLY_ms(100);                              // host registers disconnect
+  BOOT_now();                               // enter bootloader
+}
+
 // ===================================================================================
 // Main Function
 // ===================================================================================
 void main(void) {
   // Variables
-  __bit key1last = 0;                             // last state of key 1
-  __bit key2last = 0;                             // last state of key 2
-  __bit key3last = 0;                             // last state of key 3
-  __bit encAlast = 0;                             // last state of enc A
-  __bit encSWlast = 0;                            // last state of encoder switch
   __idata uint8_t i;                              // temp variable
 
   // Setup
+  TELE_init();                                    // count reset cause
   NEO_init();                                     // init NeoPixels
   CLK_config();                                   // configure system clock
   DLY_ms(10);                                     // wait for clock to settle
@@ -175,86 +705,40 @@ void main(void) {
     BOOT_now();                                   // enter bootloader
   }
 
-  // Pan flag setup
+  // Pan flag setup (sent by LED task)
   // pink:   255, 33,  140
   // yellow: 255, 216, 0
   // blue:   33,  177, 255
   NEO_writeColor(0, 255, 33,  140);
   NEO_writeColor(1, 255, 216, 0  );
   NEO_writeColor(2, 33,  177, 255);
-  NEO_update();
 
   // Init USB HID device
+  for(i=0; i<IN_COUNT; i++) IN_lock[i] = 0;       // clear debounce timers
+  CAL_init();                                     // measure delay loops
+  TICK_init();                                    // start 1ms timebase
   HID_init();                                     // init USB HID device
   DLY_ms(500);                                    // wait for Windows
   WDT_start();                                    // start watchdog timer
 
+  // Start tasks
+  TASK_every(TASK_SCAN,  SCAN_task,  1);          // scan inputs every tick
+  TASK_every(TASK_CAL,   CAL_update, 1);          // evaluate SOF measurement
+  TASK_every(TASK_SLEEP, SLEEP_task, 1);          // check for USB suspend
+  TASK_every(TASK_LED,   LED_task,   NEO_FRAME_TIME); // refresh NeoPixels
+  TASK_after(TASK_IDLE,  IDLE_task,  CLK_IDLE_TIME);  // slow down if no input
+  TASK_every(TASK_REPORT, REPORT_task, 1);        // mouse keys, mouse and gamepad
+  TASK_every(TASK_MACRO,  HID_step,    1);        // one queued macro report per tick
+  NEO_update();                                   // show first frame now
+
   // Loop
   while(1) {
-
-    // Handle key 1
-    // ------------
-    if(!PIN_read(PIN_KEY1) != key1last) {         // key state changed?
-      key1last = !key1last;                       // update last state flag
-      if(key1last) {                              // key was pressed?
-        KEY1_PRESSED();                           // take proper action
-      }
-      else {                                      // key was released?
-        KEY1_RELEASED();                          // take proper action
-      }
-    }
-
-    // Handle key 2
-    // ------------
-    if(!PIN_read(PIN_KEY2) != key2last) {         // key state changed?
-      key2last = !key2last;                       // update last state flag
-      if(key2last) {                              // key was pressed?
-        KEY2_PRESSED();                           // take proper action
-      }
-      else {                                      // key was released?
-        KEY2_RELEASED();                          // take proper action
-      }
-    }
-
-    // Handle key 3
-    // ------------
-    if(!PIN_read(PIN_KEY3) != key3last) {         // key state changed?
-      key3last = !key3last;                       // update last state flag
-      if(key3last) {                              // key was pressed?
-        KEY3_PRESSED();                           // take proper action
-      }
-      else {                                      // key was released?
-        KEY3_RELEASED();                          // take proper action
-      }
-    }
-
-    // Handle rotary encoder
-    // ---------------------
-    if(!PIN_read(PIN_ENC_A) != encAlast) {        // encoder turned ?
-      encAlast = !encAlast;                       // update last state flag
-      if(encAlast) {                              // encoder started turning
-        if(PIN_read(PIN_ENC_B)) {                 // clockwise ?
-          ENC_CW_ACTION();                        // take proper action
-        }
-        else {                                    // counter-clockwise ?
-          ENC_CCW_ACTION();                       // take proper action
-        }
-      }
-    }
-
-    // Handle encoder switch
-    // ------------
-    if(!PIN_read(PIN_ENC_SW) != encSWlast) {      // key state changed?
-      encSWlast = !encSWlast;                     // update last state flag
-      if(encSWlast) {                             // key was pressed?
-        ENC_SW_PRESSED();                         // take proper action
-      }
-      else {                                      // key was released?
-        ENC_SW_RELEASED();                        // take proper action
-      }
-    }
-
-    DLY_ms(2);                                    // debounce
+    // Every SOF (or timer0 if the bus is suspended) starts a new cycle. Inputs are
+    // scanned right at the start of the frame, so the resulting report is ready
+    // in the endpoint buffer before the host sends the IN token.
+    TICK_wait();                                  // wait for next 1ms tick
     WDT_reset();                                  // reset watchdog
+    TASK_run();                                   // run all due tasks
+    if(DIAG_bootRequest) BOOT_request();          // host wants to reflash
   }
 }
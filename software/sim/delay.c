@@ -0,0 +1,32 @@
+// ===================================================================================
+// Delay Functions - Host Simulation
+// ===================================================================================
+//
+// Replaces src/delay.c. Delays do not spin, they advance the simulated time, so
+// interrupts (SOF, IN tokens) happen during long delays just like on the chip.
+
+#include "delay.h"
+#include "system.h"
+
+// Correction of the DLY_us() units per ms for CLK_IDLE..CLK_ACTIVE, set by cal.c
+__xdata int16_t DLY_msTrim[DLY_CLK_COUNT];
+
+// Delay in units of us (nominal clock, like the loops on the chip)
+void DLY_us(uint16_t n) {
+  SIM_delay(n);
+}
+
+// Delay in units of ms
+void DLY_ms(uint16_t n) {
+  uint8_t  clk   = CLK_get();
+  uint16_t count = DLY_msCount(clk);
+  while(n) {
+    DLY_us(count);
+    n--;
+  }
+}
+
+// Cycle delays take no simulated time
+void _delay_more_cycles(uint8_t n) {
+  (void)n;
+}
@@ -0,0 +1,69 @@
+// ===================================================================================
+// NeoPixel Functions - Host Simulation
+// ===================================================================================
+//
+// Replaces src/neo.c. Instead of bit-banging the pin, the bytes are shifted into a
+// model of the pixel string; every complete string is reported as one frame.
+
+#include "neo.h"
+
+__xdata uint8_t NEO_buffer[3 * NEO_COUNT];  // pixel buffer
+__xdata uint8_t *ptr;                       // pixel buffer pointer
+
+static uint8_t NEO_strip[3 * NEO_COUNT];    // bytes received by the string
+static uint8_t NEO_pos = 0;                 // next byte in the string
+
+void NEO_sendByte(uint8_t data) {
+  NEO_strip[NEO_pos++] = data;
+  if(NEO_pos == 3 * NEO_COUNT) {            // all pixels received: latch
+    SIM_neoFrame(NEO_strip, 3 * NEO_COUNT);
+    NEO_pos = 0;
+  }
+}
+
+void NEO_update(void) {
+  uint8_t i;
+  ptr = NEO_buffer;
+  for(i=3*NEO_COUNT; i; i--) NEO_sendByte(*ptr++);
+  NEO_latch();
+}
+
+void NEO_clearAll(void) {
+  uint8_t i;
+  ptr = NEO_buffer;
+  for(i=3*NEO_COUNT; i; i--) *ptr++ = 0;
+  NEO_update();
+}
+
+void NEO_blank(void) {
+  uint8_t i;
+  for(i=3*NEO_COUNT; i; i--) NEO_sendByte(0);
+  NEO_latch();
+}
+
+void NEO_writeColor(uint8_t pixel, uint8_t r, uint8_t g, uint8_t b) {
+  ptr = NEO_buffer + (3 * pixel);
+  #if defined (NEO_GRB)
+    *ptr++ = g; *ptr++ = r; *ptr = b;
+  #elif defined (NEO_RGB)
+    *ptr++ = r; *ptr++ = g; *ptr = b;
+  #else
+    #error Wrong or missing NeoPixel type definition!
+  #endif
+}
+
+void NEO_writeHue(uint8_t pixel, uint8_t hue, uint8_t bright) {
+  uint8_t phase = hue >> 6;
+  uint8_t step  = (hue & 63) << bright;
+  uint8_t nstep = (63 << bright) - step;
+  switch(phase) {
+    case 0:   NEO_writeColor(pixel, nstep,  step,     0); break;
+    case 1:   NEO_writeColor(pixel,     0, nstep,  step); break;
+    case 2:   NEO_writeColor(pixel,  step,     0, nstep); break;
+    default:  break;
+  }
+}
+
+void NEO_clearPixel(uint8_t pixel) {
+  NEO_writeColor(pixel, 0, 0, 0);
+}
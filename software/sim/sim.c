@@ -0,0 +1,773 @@
+// ===================================================================================
+// Host Simulation of the MacroPad Plus Firmware - Bus and Device Model
+// ===================================================================================
+//
+// Usage: macropad_sim [options] [script]
+//   -t <ms>    run time (default: until "end", 1000ms after the last event)
+//   -p <ppm>   deviation of the simulated RC oscillator (default: 0)
+//   -v         verbose: also log bus events and NeoPixel frames
+//   -b         run the latency, throughput and enumeration benchmark
+//   -u         register the device with the kernel via /dev/uhid (real time)
+//
+// Script format, one event per line ('#' starts a comment):
+//   <ms> press   KEY1|KEY2|KEY3|ENC_SW     press key (pin low)
+//   <ms> release KEY1|KEY2|KEY3|ENC_SW     release key (pin high)
+//   <ms> cw | ccw                          turn encoder one detent
+//   <ms> suspend | resume                  host suspends / resumes the bus
+//   <ms> leds <hex>                        host writes keyboard LED state (report 1)
+//   <ms> feature <id> <len>                host reads a HID feature report
+//   <ms> setfeature <id> <byte>            host writes a HID feature report [id, byte]
+//   <ms> boot                              host requests the bootloader (report 0x15)
+//   <ms> cc <controller> <value>           host sends a MIDI control change (MIDI_ENABLE)
+//   <ms> raw <hex>                         host sends a raw HID packet (RAW_ENABLE)
+//   <ms> end                               end of simulation
+// Times are in ms from power-up and may have fractions (e.g. 600.25).
+//
+// Output: one line per event, starting with the simulated time in ms, e.g.
+//   602.500 EP1  01 00 00 68 00 00 00 00
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ucontext.h>
+
+#include "config.h"
+#include "ch554.h"
+#include "gpio.h"
+#include "system.h"
+#include "usb_handler.h"
+#include "uhid.h"
+
+// Firmware entry points (macropad_plus.c)
+void FW_main(void);
+void USB_ISR(void);
+void TMR0_ISR(void);
+
+// ===================================================================================
+// Simulation State
+// ===================================================================================
+#define MS              1000000ULL          // ns per ms
+#define SIM_STACK_SIZE  (256 * 1024)        // firmware stack size
+
+enum {FW_WAIT, FW_DELAY, FW_SLEEP, FW_DONE};
+enum {BUS_OFF, BUS_ACTIVE, BUS_SUSPENDED};
+
+uint64_t SIM_now = 0;                       // simulated time in ns
+int      SIM_verbose = 0;                   // log bus events and frames
+double   SIM_ppm = 0;                       // RC oscillator deviation
+
+static ucontext_t SIM_hostCtx, SIM_fwCtx;
+static uint8_t  *SIM_stack;
+static int       SIM_fw = FW_WAIT;          // firmware state
+static uint64_t  SIM_fwUntil;               // end of firmware delay
+static int       SIM_bus = BUS_OFF;         // USB bus state
+static uint64_t  SIM_tSOF = MS;             // next SOF
+static uint64_t  SIM_tIN  = MS + MS / 2;    // next IN token
+static uint64_t  SIM_tSuspend;              // time the bus went idle
+static int       SIM_enumerate = 0;         // enumeration pending
+static int       SIM_wakeSignal = 0;        // remote wakeup signaling seen
+static double    SIM_t0frac = 0;            // fractional timer0 ticks
+static double    SIM_cycfrac = 0;           // fractional system clock cycles
+static int       SIM_ctrlCount = 0;         // control transfers on EP0
+static int       SIM_ctrlPackets = 0;       // EP0 transactions (SETUP, IN, OUT)
+static int       SIM_ctrlBytes = 0;         // EP0 data bytes
+
+// Descriptors read by the simulated host during enumeration
+uint8_t SIM_devDescr[18];
+uint8_t SIM_cfgDescr[256];
+uint8_t SIM_reportDescr[1024];
+int     SIM_reportDescrLen = 0;
+
+// Input events from script or benchmark
+typedef struct {
+  uint64_t t;
+  char     cmd[16];
+  char     arg[48];
+  int      a, b;
+} SIM_event;
+
+static SIM_event *SIM_events = NULL;
+static int SIM_eventCount = 0, SIM_eventNext = 0;
+
+// Benchmark
+static int      SIM_benchMode = 0;          // benchmark running, no report log
+static int      SIM_uhid = 0;               // uhid bridge active
+static uint64_t SIM_tPress;                 // time of last key press
+
+static void SIM_benchReport(const uint8_t *buf, uint8_t len);
+static int  SIM_bench(void);
+
+// ===================================================================================
+// Logging
+// ===================================================================================
+static void SIM_log(const char *tag, const uint8_t *buf, int len, const char *text) {
+  int i;
+  printf("%10.3f %-4s", SIM_now / 1e6, tag);
+  for(i=0; i<len; i++) printf(" %02x", buf[i]);
+  if(text) printf(" %s", text);
+  printf("\n");
+}
+
+// ===================================================================================
+// Clock and Timers
+// ===================================================================================
+static const double SIM_fsys[] = {
+  187500, 750000, 3000000, 6000000, 12000000, 16000000, 24000000, 32000000
+};
+
+static double SIM_hz(void) {
+  return SIM_fsys[CLK_get()] * (1.0 + SIM_ppm / 1e6);
+}
+
+// Let time pass: run timer0 (Fsys/12) and timer2 (Fsys) unless sleeping
+static void SIM_advance(uint64_t t) {
+  double   cycles;
+  uint32_t cnt;
+  if(t <= SIM_now) return;
+  if(SIM_fw != FW_SLEEP) {
+    cycles = (t - SIM_now) * SIM_hz() / 1e9 + SIM_cycfrac;
+    SIM_cycfrac = cycles - (uint64_t)cycles;
+    if(TR2) {
+      cnt = ((TH2 << 8) | TL2) + (uint64_t)cycles;
+      TL2 = (uint8_t)cnt;
+      TH2 = (uint8_t)(cnt >> 8);
+    }
+    if(TR0) {
+      SIM_t0frac += (uint64_t)cycles / 12.0;
+      cnt = ((TH0 << 8) | TL0) + (uint32_t)SIM_t0frac;
+      SIM_t0frac -= (uint32_t)SIM_t0frac;
+      if(cnt > 0xFFFF) TF0 = 1;             // overflow
+      TL0 = (uint8_t)cnt;
+      TH0 = (uint8_t)(cnt >> 8);
+    }
+  }
+  SIM_now = t;
+}
+
+// Time of next timer0 overflow
+static uint64_t SIM_t0due(void) {
+  double ticks;
+  if(!TR0 || !ET0 || SIM_fw == FW_SLEEP) return UINT64_MAX;
+  ticks = 65536 - ((TH0 << 8) | TL0) - SIM_t0frac;
+  return SIM_now + (uint64_t)(ticks * 12 * 1e9 / SIM_hz()) + 1;
+}
+
+// ===================================================================================
+// Interrupts
+// ===================================================================================
+static void SIM_irq(void) {
+  if(!EA || SIM_fw == FW_SLEEP) return;
+  if(IE_USB && (UIF_TRANSFER || UIF_BUS_RST || UIF_SUSPEND)) USB_ISR();
+  if(ET0 && TF0) {
+    TF0 = 0;                                // cleared by hardware
+    TMR0_ISR();
+  }
+}
+
+// Complete a USB transaction and raise the transfer interrupt
+static void SIM_transfer(uint8_t token) {
+  if((token & MASK_UIS_TOKEN) != UIS_TOKEN_SOF && !(token & MASK_UIS_ENDP)) SIM_ctrlPackets++;
+  USB_INT_ST   = token;
+  UIF_TRANSFER = 1;
+  SIM_irq();
+}
+
+// ===================================================================================
+// Firmware Coroutine
+// ===================================================================================
+static void SIM_fwEntry(void) {
+  FW_main();
+  SIM_fw = FW_DONE;
+}
+
+static void SIM_resume(void) {
+  SIM_fw = FW_WAIT;
+  swapcontext(&SIM_hostCtx, &SIM_fwCtx);
+}
+
+void SIM_yield(void) {
+  SIM_fw = FW_WAIT;
+  swapcontext(&SIM_fwCtx, &SIM_hostCtx);
+}
+
+void SIM_delay(uint32_t us) {
+  // Nominal delay: on a fast oscillator the delay loops finish early
+  SIM_fwUntil = SIM_now + (uint64_t)(us * 1000.0 / (1.0 + SIM_ppm / 1e6));
+  SIM_fw = FW_DELAY;
+  swapcontext(&SIM_fwCtx, &SIM_hostCtx);
+}
+
+// Wake-up sources which are active right now
+static int SIM_wakeup(void) {
+  uint8_t w = WAKE_CTRL;
+  if((w & bWAK_RXD1_LO)  && !PIN_read(PIN_KEY3))   return 1;
+  if((w & bWAK_RXD0_LO)  && !PIN_read(PIN_ENC_B))  return 1;
+  if((w & bWAK_P3_2E_3L) && !PIN_read(PIN_ENC_SW)) return 1;
+  if((w & bWAK_BY_USB)   && SIM_bus == BUS_ACTIVE && SIM_wakeSignal == 0
+                         && !(USB_MIS_ST & bUMS_SUSPEND)) return 1;
+  return 0;
+}
+
+void SIM_sleep(void) {
+  if(SIM_wakeup()) return;                  // wake-up level already present
+  if(SIM_verbose) SIM_log("PWR", NULL, 0, "power-down");
+  SIM_fw = FW_SLEEP;
+  swapcontext(&SIM_fwCtx, &SIM_hostCtx);
+  if(SIM_verbose) SIM_log("PWR", NULL, 0, "wake-up");
+}
+
+void SIM_boot(void) {
+  SIM_log("BOOT", NULL, 0, "bootloader entered");
+  SIM_fw = FW_DONE;
+  swapcontext(&SIM_fwCtx, &SIM_hostCtx);
+}
+
+void SIM_neoFrame(const uint8_t *buf, uint8_t len) {
+  if(SIM_verbose) SIM_log("LED", buf, len, NULL);
+}
+
+// ===================================================================================
+// Simulated USB Host
+// ===================================================================================
+
+// Control transfer on EP0, returns number of bytes read/written or -1 (STALL)
+int SIM_control(uint8_t type, uint8_t req, uint16_t value, uint16_t index,
+                uint16_t length, uint8_t *data) {
+  int len = 0, n;
+
+  EP0_buffer[0] = type;
+  EP0_buffer[1] = req;
+  EP0_buffer[2] = (uint8_t)value;   EP0_buffer[3] = value >> 8;
+  EP0_buffer[4] = (uint8_t)index;   EP0_buffer[5] = index >> 8;
+  EP0_buffer[6] = (uint8_t)length;  EP0_buffer[7] = length >> 8;
+  USB_RX_LEN = 8;
+  SIM_ctrlCount++;
+  SIM_transfer(UIS_TOKEN_SETUP | 0);
+
+  if(type & USB_REQ_TYP_IN) {               // control read: IN data, OUT status
+    while(len < length) {
+      if((UEP0_CTRL & MASK_UEP_T_RES) != UEP_T_RES_ACK) return -1;
+      n = UEP0_T_LEN;
+      if(n > length - len) n = length - len;
+      memcpy(data + len, EP0_buffer, n);
+      len += n;
+      SIM_ctrlBytes += n;
+      SIM_transfer(UIS_TOKEN_IN | 0);
+      if(n < EP0_SIZE) break;               // short packet: end of data
+    }
+    USB_RX_LEN = 0;
+    SIM_transfer(UIS_TOKEN_OUT | 0);
+  }
+  else {                                    // control write: OUT data, IN status
+    while(len < length) {
+      if((UEP0_CTRL & MASK_UEP_R_RES) != UEP_R_RES_ACK) return -1;
+      n = length - len;
+      if(n > EP0_SIZE) n = EP0_SIZE;
+      memcpy(EP0_buffer, data + len, n);
+      USB_RX_LEN = n;
+      len += n;
+      SIM_ctrlBytes += n;
+      SIM_transfer(UIS_TOKEN_OUT | 0);
+    }
+    if((UEP0_CTRL & MASK_UEP_T_RES) != UEP_T_RES_ACK) return -1;
+    SIM_transfer(UIS_TOKEN_IN | 0);
+  }
+  return len;
+}
+
+// BOS descriptor and the platform capabilities it announces (bcdUSB >= 2.01),
+// requested like Windows (MS OS 2.0) and a browser (WebUSB) would
+static void SIM_bos(void) {
+  static const uint8_t msos20[16] = {0xdf, 0x60, 0xdd, 0xd8, 0x89, 0x45, 0xc7, 0x4c,
+                                     0x9c, 0xd2, 0x65, 0x9d, 0x9e, 0x64, 0x8a, 0x9f};
+  static const uint8_t webusb[16] = {0x38, 0xb6, 0x08, 0x34, 0xa9, 0x09, 0xa0, 0x47,
+                                     0x8b, 0xfd, 0xa0, 0x76, 0x88, 0x15, 0xb6, 0x65};
+  uint8_t bos[256], buf[256];
+  char    text[300];
+  int     len, i, n;
+
+  len = SIM_control(0x80, USB_GET_DESCRIPTOR, 0x0F00, 0, 5, bos);
+  if(len == 5) len = SIM_control(0x80, USB_GET_DESCRIPTOR, 0x0F00, 0, bos[2] | (bos[3] << 8), bos);
+  if(len < 5) { SIM_log("USB", NULL, 0, "BOS descriptor failed"); return; }
+  for(i=5; i + 20 <= len && bos[i]; i += bos[i]) {
+    if(bos[i+2] != 0x05) continue;          // not a platform capability
+    if(!memcmp(bos + i + 4, msos20, 16)) {
+      n = SIM_control(0xC0, bos[i+26], 0, 7, bos[i+24] | (bos[i+25] << 8), buf);
+      snprintf(text, sizeof(text), "MS OS 2.0 set %d of %d bytes, compatible ID %s "
+               "for interface %d", n, buf[8] | (buf[9] << 8), n > 36 ? (char *)buf + 30 : "?",
+               n > 36 ? buf[22] : -1);
+      SIM_log("USB", NULL, 0, text);
+    }
+    if(!memcmp(bos + i + 4, webusb, 16)) {
+      if(!bos[i+23]) { SIM_log("USB", NULL, 0, "WebUSB without landing page"); continue; }
+      n = SIM_control(0xC0, bos[i+22], bos[i+23], 2, 255, buf);
+      snprintf(text, sizeof(text), "WebUSB landing page %s%.*s", buf[2] ? "https://" : "http://",
+               n > 3 ? n - 3 : 0, (char *)buf + 3);
+      SIM_log("USB", NULL, 0, n < 3 ? "WebUSB URL failed" : text);
+    }
+  }
+}
+
+// Enumerate the device like a host would
+static void SIM_enum(void) {
+  uint8_t buf[256];
+  int     len, i, itf = 0;
+  char    text[96];
+
+  SIM_ctrlCount = SIM_ctrlPackets = SIM_ctrlBytes = 0;
+
+  len = SIM_control(0x80, USB_GET_DESCRIPTOR, 0x0100, 0, 64, SIM_devDescr);
+  if(len < 18) { SIM_log("USB", NULL, 0, "device descriptor failed"); return; }
+  SIM_control(0x00, USB_SET_ADDRESS, 1, 0, 0, NULL);
+  // Whole configuration descriptor with wLength 255 like Windows: if wTotalLength is
+  // a multiple of EP0_SIZE, the data stage ends with a zero length packet
+  len = SIM_control(0x80, USB_GET_DESCRIPTOR, 0x0200, 0, 9, SIM_cfgDescr);
+  if(len == 9) {
+    len = SIM_control(0x80, USB_GET_DESCRIPTOR, 0x0200, 0, 255, SIM_cfgDescr);
+    if(len != (SIM_cfgDescr[2] | (SIM_cfgDescr[3] << 8)))
+      SIM_log("USB", NULL, 0, "configuration descriptor length mismatch");
+  }
+  if((SIM_devDescr[2] | (SIM_devDescr[3] << 8)) >= 0x0201) SIM_bos();
+  SIM_control(0x00, USB_SET_CONFIGURATION, 1, 0, 0, NULL);
+
+  // Report descriptor of every HID interface (length from HID descriptor), the one
+  // of interface 0 is kept for the uhid bridge
+  for(i=0; i + 9 <= len; i += SIM_cfgDescr[i]) {
+    if(!SIM_cfgDescr[i]) break;
+    if(SIM_cfgDescr[i+1] == USB_DESCR_TYP_INTERF) itf = SIM_cfgDescr[i+2];
+    if(SIM_cfgDescr[i+1] == USB_DESCR_TYP_HID) {
+      int rlen = SIM_cfgDescr[i+7] | (SIM_cfgDescr[i+8] << 8);
+      if(itf) {
+        SIM_control(0x81, USB_GET_DESCRIPTOR, 0x2200, itf, rlen, buf);
+        continue;
+      }
+      if(SIM_reportDescrLen + rlen > (int)sizeof(SIM_reportDescr)) break;
+      rlen = SIM_control(0x81, USB_GET_DESCRIPTOR, 0x2200, 0, rlen,
+                         SIM_reportDescr + SIM_reportDescrLen);
+      if(rlen > 0) SIM_reportDescrLen += rlen;
+    }
+  }
+
+  // Strings like a typical host
+  for(i=0; i<4; i++) SIM_control(0x80, USB_GET_DESCRIPTOR, 0x0300 | i, 0x0409, 255, buf);
+
+  snprintf(text, sizeof(text), "enumerated %04x:%04x, report descriptor %d bytes, "
+           "%d EP0 transactions", SIM_devDescr[8] | (SIM_devDescr[9] << 8),
+           SIM_devDescr[10] | (SIM_devDescr[11] << 8), SIM_reportDescrLen, SIM_ctrlPackets);
+  SIM_log("USB", NULL, 0, text);
+}
+
+// OUT transfer on EP2 (output report)
+void SIM_output(const uint8_t *buf, uint8_t len) {
+  if(SIM_bus != BUS_ACTIVE || !(UEP2_3_MOD & bUEP2_RX_EN)) return;
+  if((UEP2_CTRL & MASK_UEP_R_RES) != UEP_R_RES_ACK) return;
+  memcpy(EP2_buffer, buf, len);
+  USB_RX_LEN = len;
+  SIM_transfer(UIS_TOKEN_OUT | 2);
+}
+
+// Start of frame
+static void SIM_sof(void) {
+  if(SIM_bus == BUS_OFF && (USB_CTRL & bUC_DEV_PU_EN)) {
+    SIM_bus = BUS_ACTIVE;                   // device attached: reset bus
+    UIF_BUS_RST = 1;
+    SIM_irq();
+    SIM_enumerate = 1;
+    return;
+  }
+  if(SIM_bus == BUS_SUSPENDED) {
+    if(!(USB_MIS_ST & bUMS_SUSPEND) && SIM_now - SIM_tSuspend >= 3 * MS) {
+      USB_MIS_ST |= bUMS_SUSPEND;           // 3ms idle: suspend
+      UIF_SUSPEND = 1;
+      if(SIM_verbose) SIM_log("USB", NULL, 0, "suspend");
+      SIM_irq();
+    }
+    if(UDEV_CTRL & bUD_LOW_SPEED) {         // device drives K-state
+      if(!SIM_wakeSignal) SIM_log("USB", NULL, 0, "remote wakeup");
+      SIM_wakeSignal = 1;
+    }
+    else if(SIM_wakeSignal) {               // signaling ended: host resumes
+      SIM_wakeSignal = 0;
+      SIM_bus = BUS_ACTIVE;
+      USB_MIS_ST &= ~bUMS_SUSPEND;
+      UIF_SUSPEND = 1;
+      SIM_irq();
+    }
+    return;
+  }
+  if(SIM_bus != BUS_ACTIVE) return;
+  if(SIM_enumerate) {
+    SIM_enumerate = 0;
+    SIM_enum();
+    if(SIM_uhid) UHID_create(SIM_reportDescr, SIM_reportDescrLen,
+                             SIM_devDescr[8] | (SIM_devDescr[9] << 8),
+                             SIM_devDescr[10] | (SIM_devDescr[11] << 8));
+  }
+  if((USB_INT_EN & bUIE_DEV_SOF) && !UIF_TRANSFER) SIM_transfer(UIS_TOKEN_SOF | 0);
+}
+
+// IN token for the interrupt endpoint(s)
+static void SIM_poll(void) {
+  uint8_t len;
+  if(SIM_bus != BUS_ACTIVE || UIF_TRANSFER) return;   // no bus or busy (NAK)
+  if((UEP4_1_MOD & bUEP1_TX_EN) && (UEP1_CTRL & MASK_UEP_T_RES) == UEP_T_RES_ACK) {
+    len = UEP1_T_LEN;
+    if(SIM_benchMode) SIM_benchReport(EP1_buffer, len);
+    else SIM_log("EP1", EP1_buffer, len, NULL);
+    if(SIM_uhid) UHID_input(EP1_buffer, len);
+    SIM_transfer(UIS_TOKEN_IN | 1);
+  }
+#ifdef MIDI_ENABLE
+  if(UIF_TRANSFER) return;
+  if((UEP2_3_MOD & bUEP3_TX_EN) && (UEP3_CTRL & MASK_UEP_T_RES) == UEP_T_RES_ACK) {
+    if(!SIM_benchMode) SIM_log("MIDI", EP3_buffer + 64, UEP3_T_LEN, NULL);
+    SIM_transfer(UIS_TOKEN_IN | 3);
+  }
+#endif
+#ifdef RAW_ENABLE
+  if(UIF_TRANSFER) return;
+  if((UEP4_1_MOD & bUEP4_TX_EN) && (UEP4_CTRL & MASK_UEP_T_RES) == UEP_T_RES_ACK) {
+    if(!SIM_benchMode) SIM_log("RAW", EP4_buffer + 64, UEP4_T_LEN, NULL);
+    SIM_transfer(UIS_TOKEN_IN | 4);
+  }
+#endif
+}
+
+#ifdef MIDI_ENABLE
+// Bulk OUT packet to the MIDI endpoint (dropped if the device NAKs)
+static void SIM_midiOut(const uint8_t *buf, uint8_t len) {
+  if(SIM_bus != BUS_ACTIVE || !(UEP2_3_MOD & bUEP3_RX_EN)) return;
+  if((UEP3_CTRL & MASK_UEP_R_RES) != UEP_R_RES_ACK) return;
+  memcpy(EP3_buffer, buf, len);
+  USB_RX_LEN = len;
+  U_TOG_OK = 1;
+  SIM_transfer(UIS_TOKEN_OUT | 3);
+}
+#endif
+
+#ifdef RAW_ENABLE
+// Interrupt OUT packet to the raw HID endpoint (dropped if the device NAKs)
+static void SIM_rawOut(const uint8_t *buf, uint8_t len) {
+  if(SIM_bus != BUS_ACTIVE || !(UEP4_1_MOD & bUEP4_RX_EN)) return;
+  if((UEP4_CTRL & MASK_UEP_R_RES) != UEP_R_RES_ACK) return;
+  memcpy(EP4_buffer, buf, len);
+  USB_RX_LEN = len;
+  U_TOG_OK = 1;
+  SIM_transfer(UIS_TOKEN_OUT | 4);
+}
+#endif
+
+// ===================================================================================
+// Input Events
+// ===================================================================================
+static volatile uint8_t *SIM_pin(const char *name) {
+  if(!strcmp(name, "KEY1"))   return &PIN_read(PIN_KEY1);
+  if(!strcmp(name, "KEY2"))   return &PIN_read(PIN_KEY2);
+  if(!strcmp(name, "KEY3"))   return &PIN_read(PIN_KEY3);
+  if(!strcmp(name, "ENC_SW")) return &PIN_read(PIN_ENC_SW);
+  if(!strcmp(name, "ENC_A"))  return &PIN_read(PIN_ENC_A);
+  if(!strcmp(name, "ENC_B"))  return &PIN_read(PIN_ENC_B);
+  return NULL;
+}
+
+void SIM_addEvent(uint64_t t, const char *cmd, const char *arg, int a, int b) {
+  SIM_event *e;
+  int i;
+  SIM_events = realloc(SIM_events, (SIM_eventCount + 1) * sizeof(SIM_event));
+  for(i=SIM_eventCount; i>0 && SIM_events[i-1].t > t; i--) SIM_events[i] = SIM_events[i-1];
+  e = &SIM_events[i];
+  e->t = t;
+  snprintf(e->cmd, sizeof(e->cmd), "%s", cmd);
+  snprintf(e->arg, sizeof(e->arg), "%s", arg ? arg : "");
+  e->a = a;
+  e->b = b;
+  SIM_eventCount++;
+}
+
+// Returns 0 at the end of the simulation
+static int SIM_doEvent(SIM_event *e) {
+  volatile uint8_t *pin;
+  uint8_t buf[256];
+  int len;
+
+  if(!strcmp(e->cmd, "end")) return 0;
+  if(!strcmp(e->cmd, "press") || !strcmp(e->cmd, "release") || !strcmp(e->cmd, "pin")) {
+    if(!(pin = SIM_pin(e->arg))) {
+      fprintf(stderr, "unknown pin: %s\n", e->arg);
+      return 1;
+    }
+    *pin = !strcmp(e->cmd, "pin") ? e->a : !strcmp(e->cmd, "release");
+    if(!strcmp(e->cmd, "press")) SIM_tPress = SIM_now;
+  }
+  else if(!strcmp(e->cmd, "cw") || !strcmp(e->cmd, "ccw")) {
+    // One quadrature cycle, A falls at the start and rises after 1.5ms, B tells
+    // the direction (cw: A leads B, ccw: B leads A)
+    if(!strcmp(e->cmd, "cw")) {
+      PIN_write(PIN_ENC_B, 1);
+      SIM_addEvent(e->t + 3 * MS / 4, "pin", "ENC_B", 0, 0);
+      SIM_addEvent(e->t + 9 * MS / 4, "pin", "ENC_B", 1, 0);
+    }
+    else {
+      PIN_write(PIN_ENC_B, 0);
+      SIM_addEvent(e->t + 3 * MS / 4, "pin", "ENC_B", 1, 0);
+    }
+    PIN_write(PIN_ENC_A, 0);
+    SIM_addEvent(e->t + 3 * MS / 2, "pin", "ENC_A", 1, 0);
+  }
+  else if(!strcmp(e->cmd, "suspend")) {
+    // Like most hosts, allow remote wakeup if the device supports it
+    if(SIM_bus == BUS_ACTIVE && (SIM_cfgDescr[7] & 0x20))
+      SIM_control(0x00, USB_SET_FEATURE, 1, 0, 0, NULL);
+    if(SIM_bus == BUS_ACTIVE) SIM_bus = BUS_SUSPENDED;
+    SIM_tSuspend = SIM_now;
+  }
+  else if(!strcmp(e->cmd, "resume")) {
+    if(SIM_bus == BUS_SUSPENDED) {
+      SIM_bus = BUS_ACTIVE;
+      USB_MIS_ST &= ~bUMS_SUSPEND;
+      UIF_SUSPEND = 1;
+      SIM_irq();
+    }
+  }
+  else if(!strcmp(e->cmd, "leds")) {
+    buf[0] = 1;                             // keyboard report ID
+    buf[1] = (uint8_t)e->a;
+    SIM_output(buf, 2);
+  }
+  else if(!strcmp(e->cmd, "feature")) {
+    len = SIM_control(0xA1, HID_GET_REPORT, 0x0300 | e->a, 0, e->b > 255 ? 255 : e->b, buf);
+    SIM_log("FEAT", buf, len < 0 ? 0 : len, len < 0 ? "STALL" : NULL);
+  }
+  else if(!strcmp(e->cmd, "setfeature")) {
+    buf[0] = (uint8_t)e->a;
+    buf[1] = (uint8_t)e->b;
+    len = SIM_control(0x21, HID_SET_REPORT, 0x0300 | e->a, 0, 2, buf);
+    SIM_log("SETF", buf, 2, len < 0 ? "STALL" : NULL);
+  }
+  else if(!strcmp(e->cmd, "boot")) {
+    buf[0] = 0x15;                          // bootloader request, see diag.h
+    memcpy(buf + 1, "BOOT", 4);
+    len = SIM_control(0x21, HID_SET_REPORT, 0x0315, 0, 5, buf);
+    SIM_log("SETF", buf, 5, len < 0 ? "STALL" : NULL);
+  }
+#ifdef MIDI_ENABLE
+  else if(!strcmp(e->cmd, "cc")) {
+    buf[0] = 0x0B;                          // cable 0, control change
+    buf[1] = 0xB0 | MIDI_CHANNEL;
+    buf[2] = (uint8_t)e->a;
+    buf[3] = (uint8_t)e->b;
+    SIM_log("CC", buf, 4, NULL);
+    SIM_midiOut(buf, 4);
+  }
+#endif
+#ifdef RAW_ENABLE
+  else if(!strcmp(e->cmd, "raw")) {
+    memset(buf, 0, 64);                     // full 64-byte packet
+    for(len=0; len < (int)strlen(e->arg) / 2; len++) sscanf(e->arg + 2 * len, "%2hhx", &buf[len]);
+    SIM_log("RAWO", buf, len, NULL);
+    SIM_rawOut(buf, 64);
+  }
+#endif
+  else fprintf(stderr, "unknown command: %s\n", e->cmd);
+  return 1;
+}
+
+// Read script file (see top of file)
+int SIM_loadScript(FILE *f) {
+  char line[256], cmd[16], arg[48];
+  double t;
+  int n, a, b;
+  while(fgets(line, sizeof(line), f)) {
+    char *c = strchr(line, '#');
+    if(c) *c = 0;
+    arg[0] = 0; a = b = 0;
+    n = sscanf(line, "%lf %15s %47s %i", &t, cmd, arg, &b);
+    if(n < 2) continue;
+    if(!strcmp(cmd, "leds") || !strcmp(cmd, "feature") || !strcmp(cmd, "setfeature") ||
+       !strcmp(cmd, "cc")) a = (int)strtol(arg, NULL, 0);
+    SIM_addEvent((uint64_t)(t * MS), cmd, arg, a, b);
+  }
+  return 0;
+}
+
+// ===================================================================================
+// Main Loop of the Simulation
+// ===================================================================================
+void SIM_init(void) {
+  // Reset values of the registers used by the bus model
+  P1 = 0xFF; P3 = 0xFF;
+  PCON = RST_FLAG_POR;                      // power-on reset
+  PP10 = PP11 = PP12 = PP13 = PP14 = PP15 = PP16 = PP17 = 1;
+  PP30 = PP31 = PP32 = PP33 = PP34 = PP35 = PP36 = PP37 = 1;
+  // CLK_config() is inline assembly, so start with the selected clock already
+  CLOCK_CFG = bOSC_EN_INT | (F_CPU == 32000000 ? CLK_32MHZ : F_CPU == 24000000 ? CLK_24MHZ :
+                             F_CPU == 16000000 ? CLK_16MHZ : F_CPU == 12000000 ? CLK_12MHZ :
+                             CLK_6MHZ);
+
+  SIM_stack = malloc(SIM_STACK_SIZE);
+  getcontext(&SIM_fwCtx);
+  SIM_fwCtx.uc_stack.ss_sp   = SIM_stack;
+  SIM_fwCtx.uc_stack.ss_size = SIM_STACK_SIZE;
+  SIM_fwCtx.uc_link          = &SIM_hostCtx;
+  makecontext(&SIM_fwCtx, SIM_fwEntry, 0);
+  SIM_resume();                             // run firmware until it waits
+}
+
+// Run simulation until time end (ns), returns 0 if script ended
+int SIM_run(uint64_t end) {
+  uint64_t t, tT0;
+  while(SIM_fw != FW_DONE) {
+    SIM_irq();                              // deliver pending interrupts
+
+    // Next event
+    t = SIM_tSOF < SIM_tIN ? SIM_tSOF : SIM_tIN;
+    if(SIM_eventNext < SIM_eventCount && SIM_events[SIM_eventNext].t < t)
+      t = SIM_events[SIM_eventNext].t;
+    tT0 = SIM_t0due();
+    if(tT0 < t) t = tT0;
+    if(SIM_fw == FW_DELAY && SIM_fwUntil <= t) {
+      SIM_advance(SIM_fwUntil);             // delay over: continue firmware
+      SIM_resume();
+      continue;
+    }
+    if(t > end) {
+      SIM_advance(end);
+      return 1;
+    }
+    if(SIM_uhid) UHID_pace(t);              // real time, serve kernel requests
+    SIM_advance(t);
+
+    // Process event
+    if(t == tT0) SIM_irq();                 // timer0 overflow
+    if(SIM_eventNext < SIM_eventCount && SIM_events[SIM_eventNext].t == t) {
+      SIM_event e = SIM_events[SIM_eventNext++];   // list may grow meanwhile
+      if(!SIM_doEvent(&e)) return 0;
+    }
+    else if(t == SIM_tSOF) {
+      SIM_sof();
+      SIM_tSOF += MS;
+    }
+    else if(t == SIM_tIN) {
+      SIM_poll();
+      SIM_tIN += MS;
+    }
+
+    // Wake up from sleep or continue waiting firmware
+    if(SIM_fw == FW_SLEEP && SIM_wakeup()) SIM_fw = FW_WAIT;
+    if(SIM_fw == FW_WAIT) {
+      SIM_irq();
+      SIM_resume();
+    }
+  }
+  return 0;
+}
+
+// ===================================================================================
+// Benchmark
+// ===================================================================================
+// Key latency: KEY1 is pressed BENCH_PRESSES times, each time at a different phase
+// relative to the USB frame, the time until the first report is polled is measured.
+// Throughput: the encoder is turned as fast as the debouncing allows for one second,
+// the number of reports polled by the host is counted.
+// Only the firmware's scheduling is measured, execution time of the code is zero.
+#define BENCH_START     1000                // start after enumeration (ms)
+#define BENCH_PRESSES   200                 // number of key presses
+#define BENCH_PERIOD    50                  // time between key presses (ms)
+#define BENCH_TURN      4                   // time between encoder turns (ms)
+
+static int      SIM_benchWait = 0;          // waiting for report after press
+static int      SIM_benchCount = 0;         // number of measured presses
+static uint64_t SIM_benchMin = UINT64_MAX, SIM_benchMax = 0, SIM_benchSum = 0;
+static uint32_t SIM_benchReports = 0;       // reports polled
+
+static void SIM_benchReport(const uint8_t *buf, uint8_t len) {
+  uint64_t d;
+  (void)buf; (void)len;
+  SIM_benchReports++;
+  if(!SIM_benchWait) return;
+  SIM_benchWait = 0;
+  d = SIM_now - SIM_tPress;
+  if(d < SIM_benchMin) SIM_benchMin = d;
+  if(d > SIM_benchMax) SIM_benchMax = d;
+  SIM_benchSum += d;
+  SIM_benchCount++;
+}
+
+static int SIM_bench(void) {
+  uint64_t t = BENCH_START * MS, end;
+  int i;
+
+  // Key presses with phase stepping through the frame in 37us steps
+  for(i=0; i<BENCH_PRESSES; i++, t += BENCH_PERIOD * MS) {
+    SIM_addEvent(t + (i * 37000ULL) % MS, "press", "KEY1", 0, 0);
+    SIM_addEvent(t + (i * 37000ULL) % MS + BENCH_PERIOD * MS / 2, "release", "KEY1", 0, 0);
+  }
+
+  SIM_benchMode = 1;
+  SIM_init();
+  for(i=0; i<SIM_eventCount; i++) {
+    // Run until each press, then arm the measurement
+    if(strcmp(SIM_events[i].cmd, "press")) continue;
+    SIM_run(SIM_events[i].t);
+    SIM_benchWait = 1;
+  }
+  SIM_run(t);
+  if(!SIM_benchCount) {
+    fprintf(stderr, "No reports received!\n");
+    return 1;
+  }
+  printf("Key latency (%d presses): min %.3f ms, avg %.3f ms, max %.3f ms\n",
+         SIM_benchCount, SIM_benchMin / 1e6, SIM_benchSum / 1e6 / SIM_benchCount,
+         SIM_benchMax / 1e6);
+
+  // Encoder turns
+  end = t + 1000 * MS;
+  for(; t<end; t += BENCH_TURN * MS) SIM_addEvent(t, "cw", NULL, 0, 0);
+  SIM_benchReports = 0;
+  SIM_run(end);
+  printf("Throughput (encoder every %d ms): %u reports/s\n", BENCH_TURN, SIM_benchReports);
+  printf("Enumeration (EP0 %d bytes): %d control transfers, %d transactions, %d data bytes\n",
+         EP0_SIZE, SIM_ctrlCount, SIM_ctrlPackets, SIM_ctrlBytes);
+  return 0;
+}
+
+// ===================================================================================
+// Main Function
+// ===================================================================================
+int main(int argc, char **argv) {
+  double runtime = 0;
+  int    bench = 0, i;
+  FILE  *f;
+
+  for(i=1; i<argc; i++) {
+    if(!strcmp(argv[i], "-v")) SIM_verbose = 1;
+    else if(!strcmp(argv[i], "-b")) bench = 1;
+    else if(!strcmp(argv[i], "-u")) SIM_uhid = 1;
+    else if(!strcmp(argv[i], "-t") && i + 1 < argc) runtime = atof(argv[++i]);
+    else if(!strcmp(argv[i], "-p") && i + 1 < argc) SIM_ppm = atof(argv[++i]);
+    else if(argv[i][0] == '-' && argv[i][1]) {
+      fprintf(stderr, "Usage: %s [-v] [-b] [-u] [-t ms] [-p ppm] [script|-]\n", argv[0]);
+      return 1;
+    }
+    else {
+      f = strcmp(argv[i], "-") ? fopen(argv[i], "r") : stdin;
+      if(!f) {
+        perror(argv[i]);
+        return 1;
+      }
+      SIM_loadScript(f);
+      if(f != stdin) fclose(f);
+    }
+  }
+
+  if(SIM_uhid && UHID_open()) return 1;
+  if(bench) i = SIM_bench();
+  else {
+    if(runtime == 0) runtime = 1000 + (SIM_eventCount ? SIM_events[SIM_eventCount-1].t / 1e6 : 0);
+    SIM_init();
+    SIM_run((uint64_t)(runtime * MS));
+    i = 0;
+  }
+  UHID_close();
+  return i;
+}
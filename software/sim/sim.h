@@ -0,0 +1,64 @@
+// ===================================================================================
+// Host Simulation of the MacroPad Plus Firmware
+// ===================================================================================
+//
+// Compiles the firmware (macropad_plus.c and src/*.c) with gcc or clang for the 
+// host. This header is force-included into every file (-include sim.h) and maps the
+// SDCC extensions to standard C:
+// - Every SFR and SBIT becomes a plain variable (merged across files by -fcommon).
+//   Bits are NOT aliased to their SFR byte, the bus model uses the bit variables.
+// - __xdata/__code/__at disappear, so endpoint buffers are normal arrays and the
+//   bus model accesses them by name instead of by DMA address.
+// - Interrupt service routines become normal functions, which the bus model calls
+//   when the interrupt is enabled and the firmware is waiting (WAIT_hook) or in a
+//   delay. This makes every run deterministic.
+//
+// The firmware runs as a coroutine (main is renamed to FW_main). The modules which
+// only make sense on the chip are replaced: sim/delay.c advances the simulated
+// time and sim/neo.c records the NeoPixel frames.
+//
+// Simulated time advances in 1ms USB frames: SOF at the start of the frame, IN
+// token for the HID endpoint in the middle of the frame.
+
+#pragma once
+#include <stdint.h>
+
+// SDCC keywords
+#define __sfr           volatile uint8_t
+#define __sfr16         volatile uint16_t
+#define __sfr32         volatile uint32_t
+#define __sbit          volatile uint8_t
+#define __bit           uint8_t
+#define __at(x)
+#define __xdata
+#define __data
+#define __idata
+#define __pdata
+#define __code          const
+#define __naked
+#define __reentrant
+#define __critical
+#define __nonbanked
+#define __interrupt(x)
+#define __using(x)
+#define __asm__(...)
+
+// Hooks into the firmware (see system.h)
+#define WAIT_hook()     SIM_yield()
+#define SLEEP_now()     SIM_sleep()
+#define BOOT_now()      SIM_boot()
+
+void SIM_yield(void);                       // let the bus model run
+void SIM_sleep(void);                       // power-down until wake-up event
+void SIM_boot(void);                        // firmware jumped to bootloader
+void SIM_delay(uint32_t us);                // let simulated time pass
+
+// NeoPixel frame written by the firmware (sim/neo.c)
+void SIM_neoFrame(const uint8_t *buf, uint8_t len);
+
+// Simulated USB host (sim.c), used by the uhid bridge
+extern uint64_t SIM_now;                    // simulated time in ns
+extern int      SIM_verbose;                // log bus events and frames
+int  SIM_control(uint8_t type, uint8_t req, uint16_t value, uint16_t index,
+                 uint16_t length, uint8_t *data);   // control transfer on EP0
+void SIM_output(const uint8_t *buf, uint8_t len);   // OUT transfer on EP2
@@ -0,0 +1,166 @@
+// ===================================================================================
+// Host Simulation - Virtual HID Device via Linux uhid
+// ===================================================================================
+//
+// The simulation runs in real time while the bridge is active: before each event
+// UHID_pace() sleeps until the wall clock has caught up with the simulated time and
+// serves the requests of the kernel meanwhile. The time between the IN token in
+// the simulation and the completed write to the kernel is recorded, so consumers
+// (evdev, hidraw) see the report stream with the timing of the real device.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/uhid.h>
+
+#include "usb.h"
+#include "uhid.h"
+
+static int      UHID_fd = -1;               // /dev/uhid
+static int      UHID_created = 0;           // device registered
+static uint64_t UHID_start;                 // wall clock at simulated time 0
+static uint32_t UHID_count = 0;             // forwarded input reports
+static uint64_t UHID_lagSum = 0, UHID_lagMax = 0;
+
+// Monotonic wall clock in ns
+static uint64_t UHID_clock(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void UHID_write(struct uhid_event *ev) {
+  if(write(UHID_fd, ev, sizeof(*ev)) != sizeof(*ev))
+    fprintf(stderr, "uhid: write failed: %s\n", strerror(errno));
+}
+
+// ===================================================================================
+// Device Setup
+// ===================================================================================
+int UHID_open(void) {
+  UHID_fd = open("/dev/uhid", O_RDWR | O_CLOEXEC);
+  if(UHID_fd < 0) {
+    perror("/dev/uhid");
+    return -1;
+  }
+  UHID_start = UHID_clock();
+  return 0;
+}
+
+void UHID_create(const uint8_t *descr, uint16_t len, uint16_t vid, uint16_t pid) {
+  struct uhid_event ev;
+  if(UHID_fd < 0 || UHID_created) return;
+  if(len > HID_MAX_DESCRIPTOR_SIZE) len = HID_MAX_DESCRIPTOR_SIZE;
+  memset(&ev, 0, sizeof(ev));
+  ev.type = UHID_CREATE2;
+  snprintf((char *)ev.u.create2.name, sizeof(ev.u.create2.name), "MacroPad Plus (simulated)");
+  snprintf((char *)ev.u.create2.phys, sizeof(ev.u.create2.phys), "macropad_sim");
+  ev.u.create2.rd_size = len;
+  ev.u.create2.bus     = BUS_USB;
+  ev.u.create2.vendor  = vid;
+  ev.u.create2.product = pid;
+  memcpy(ev.u.create2.rd_data, descr, len);
+  UHID_write(&ev);
+  UHID_created = 1;
+}
+
+void UHID_close(void) {
+  struct uhid_event ev;
+  if(UHID_fd < 0) return;
+  if(UHID_created) {
+    memset(&ev, 0, sizeof(ev));
+    ev.type = UHID_DESTROY;
+    UHID_write(&ev);
+  }
+  close(UHID_fd);
+  UHID_fd = -1;
+  if(UHID_count)
+    printf("uhid: %u reports, lag to kernel avg %.3f ms, max %.3f ms\n", UHID_count,
+           UHID_lagSum / 1e6 / UHID_count, UHID_lagMax / 1e6);
+}
+
+// ===================================================================================
+// Report Transfer
+// ===================================================================================
+
+// Input report polled from EP1 at the current simulated time
+void UHID_input(const uint8_t *buf, uint8_t len) {
+  struct uhid_event ev;
+  uint64_t lag;
+  if(!UHID_created) return;
+  memset(&ev, 0, sizeof(ev));
+  ev.type = UHID_INPUT2;
+  ev.u.input2.size = len;
+  memcpy(ev.u.input2.data, buf, len);
+  UHID_write(&ev);
+  lag = UHID_clock() - UHID_start;
+  lag = lag > SIM_now ? lag - SIM_now : 0;
+  if(lag > UHID_lagMax) UHID_lagMax = lag;
+  UHID_lagSum += lag;
+  UHID_count++;
+}
+
+// Request from the kernel (output report, GET_REPORT, SET_REPORT)
+static void UHID_request(void) {
+  struct uhid_event ev, reply;
+  uint8_t type;
+  int len;
+
+  if(read(UHID_fd, &ev, sizeof(ev)) <= 0) return;
+  memset(&reply, 0, sizeof(reply));
+  switch(ev.type) {
+    case UHID_OUTPUT:
+      SIM_output(ev.u.output.data, ev.u.output.size);
+      break;
+    case UHID_GET_REPORT:
+      // The kernel does not pass the length the reader asked for, so the whole
+      // reply buffer is offered (feature reports can be longer than EP0)
+      type = ev.u.get_report.rtype == UHID_FEATURE_REPORT ? 3 :
+             ev.u.get_report.rtype == UHID_OUTPUT_REPORT  ? 2 : 1;
+      len  = SIM_control(0xA1, HID_GET_REPORT, (type << 8) | ev.u.get_report.rnum, 0,
+                         sizeof(reply.u.get_report_reply.data), reply.u.get_report_reply.data);
+      reply.type = UHID_GET_REPORT_REPLY;
+      reply.u.get_report_reply.id   = ev.u.get_report.id;
+      reply.u.get_report_reply.err  = len < 0 ? EIO : 0;
+      reply.u.get_report_reply.size = len < 0 ? 0 : len;
+      UHID_write(&reply);
+      break;
+    case UHID_SET_REPORT:
+      type = ev.u.set_report.rtype == UHID_FEATURE_REPORT ? 3 : 2;
+      len  = SIM_control(0x21, HID_SET_REPORT, (type << 8) | ev.u.set_report.rnum, 0,
+                         ev.u.set_report.size, ev.u.set_report.data);
+      reply.type = UHID_SET_REPORT_REPLY;
+      reply.u.set_report_reply.id  = ev.u.set_report.id;
+      reply.u.set_report_reply.err = len < 0 ? EIO : 0;
+      UHID_write(&reply);
+      break;
+    default:
+      if(SIM_verbose) printf("%10.3f UHID event %u\n", SIM_now / 1e6, ev.type);
+      break;
+  }
+}
+
+// Wait until the wall clock reaches simulated time t, serve kernel meanwhile
+void UHID_pace(uint64_t t) {
+  struct pollfd   pfd;
+  struct timespec ts;
+  uint64_t now;
+
+  if(UHID_fd < 0) return;
+  pfd.fd     = UHID_fd;
+  pfd.events = POLLIN;
+  while(1) {
+    now = UHID_clock() - UHID_start;
+    if(now >= t) ts.tv_sec = ts.tv_nsec = 0;
+    else {
+      ts.tv_sec  = (t - now) / 1000000000ULL;
+      ts.tv_nsec = (t - now) % 1000000000ULL;
+    }
+    if(ppoll(&pfd, 1, &ts, NULL) > 0 && (pfd.revents & POLLIN)) UHID_request();
+    else if(now >= t || UHID_clock() - UHID_start >= t) break;
+  }
+}
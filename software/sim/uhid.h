@@ -0,0 +1,17 @@
+// ===================================================================================
+// Host Simulation - Virtual HID Device via Linux uhid
+// ===================================================================================
+//
+// Registers the simulated MacroPad as a HID device with the kernel (/dev/uhid),
+// using the report descriptor read during enumeration. Input reports polled from
+// EP1 go to the kernel, output and feature reports from the kernel go back to the
+// firmware through the simulated host. Needs write access to /dev/uhid.
+
+#pragma once
+#include <stdint.h>
+
+int  UHID_open(void);                       // open /dev/uhid, returns 0 on success
+void UHID_create(const uint8_t *descr, uint16_t len, uint16_t vid, uint16_t pid);
+void UHID_input(const uint8_t *buf, uint8_t len);   // forward input report
+void UHID_pace(uint64_t t);                 // wait for wall clock, serve kernel
+void UHID_close(void);                      // destroy device, print statistics
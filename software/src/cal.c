@@ -0,0 +1,124 @@
+// ===================================================================================
+// Oscillator Calibration Functions for CH551, CH552 and CH554
+// ===================================================================================
+
+#include "cal.h"
+#include "system.h"
+#include "delay.h"
+
+#if CLK_IDLE < CLK_12MHZ || CLK_ACTIVE < CLK_IDLE
+#error "CLK_IDLE must be at least CLK_12MHZ and must not exceed CLK_ACTIVE"
+#endif
+
+__xdata int16_t  CAL_error  = 0;            // clock deviation in ppm
+__xdata uint16_t CAL_cycles = 0;            // measured cycles per ms
+__xdata uint8_t  CAL_clock  = 0;            // clock selection of measurement
+__bit CAL_valid = 0;                        // measurement available
+
+volatile __xdata uint32_t CAL_sum;          // sum of cycles over all frames
+volatile __xdata uint16_t CAL_last;         // cycle counter at last SOF
+volatile __xdata uint16_t CAL_min, CAL_max; // plausible cycles per frame
+volatile __xdata uint8_t  CAL_count = 0;    // frames left to measure
+volatile __xdata uint8_t  CAL_clk;          // clock selection during measurement
+volatile __bit CAL_done = 0;                // measurement finished
+__xdata uint16_t CAL_timer;                 // time to next measurement in ms
+__xdata uint16_t CAL_base[DLY_CLK_COUNT];   // uncorrected DLY_us() units per ms
+
+// Nominal cycles per ms, index: CLK_get() (0 = too slow to be measured)
+__code uint16_t CAL_nominal[] = {
+  0, 0, 0, 6000, 12000, 16000, 24000, 32000
+};
+
+// ===================================================================================
+// Start Cycle Counter and Measure Delay Loops
+// ===================================================================================
+// The number of cycles DLY_us() needs per us does not change with the oscillator,
+// so it is measured only once for each clock the firmware runs at (CLK_IDLE..
+// CLK_ACTIVE). A 500us delay is used, short enough that the USB interrupt is only
+// deferred, not lost, while interrupts are off.
+void CAL_init(void) {
+  uint8_t  clk = CLK_get();
+  uint8_t  i;
+  uint16_t t;
+
+  CYC_start();                              // start cycle counter
+  for(i=0; i<DLY_CLK_COUNT; i++) {
+    CLK_set(CLK_IDLE + i);                  // select clock to measure
+    EA = 0;                                 // no interrupts while measuring
+    t = CYC_read();
+    DLY_us(500);
+    t = CYC_read() - t;                     // cycles for 500 units
+    EA = 1;
+    CAL_base[i]   = (uint32_t)500 * CAL_nominal[CLK_IDLE + i] / t;
+    DLY_msTrim[i] = CAL_base[i] - 1000;
+  }
+  CLK_set(clk);                             // restore clock
+  CAL_timer = 1;                            // first measurement on next update
+}
+
+// ===================================================================================
+// Start New Measurement
+// ===================================================================================
+void CAL_start(void) {
+  CAL_done  = 0;
+  CAL_clk   = 0xFF;                         // first SOF only sets the start point
+  CAL_count = CAL_FRAMES;
+}
+
+// ===================================================================================
+// Evaluate Measurement (every tick)
+// ===================================================================================
+void CAL_update(void) {
+  uint8_t  i;
+  uint16_t nominal;
+  int32_t  diff;
+
+  if(CAL_count) return;                     // measurement still running
+  if(!CAL_done) {                           // waiting for next measurement?
+    if(!--CAL_timer) CAL_start();
+    return;
+  }
+
+  // Deviation in ppm: diff / (CAL_FRAMES * nominal) * 10^6
+  nominal    = CAL_nominal[CAL_clk];
+  diff       = (int32_t)CAL_sum - (uint32_t)CAL_FRAMES * nominal;
+  CAL_error  = diff * (1000000 / CAL_FRAMES) / nominal;
+  CAL_cycles = CAL_sum / CAL_FRAMES;
+  CAL_clock  = CAL_clk;
+  CAL_valid  = 1;
+
+  // Correct delay loops: scale by real / nominal clock
+  for(i=0; i<DLY_CLK_COUNT; i++)
+    DLY_msTrim[i] = (uint32_t)CAL_base[i] * CAL_sum / ((uint32_t)CAL_FRAMES * nominal) - 1000;
+
+  CAL_done  = 0;
+  CAL_timer = CAL_INTERVAL;
+}
+
+// ===================================================================================
+// SOF Handler (called by USB interrupt)
+// ===================================================================================
+// Frames with a cycle count off by more than 1/16 (missed SOF) and clock changes
+// restart the measurement.
+void CAL_SOF(void) {
+  uint16_t now, cycles;
+  uint8_t  clk;
+
+  if(!CAL_count) return;                    // no measurement running
+  now      = CYC_read();
+  cycles   = now - CAL_last;
+  CAL_last = now;
+  clk      = CLK_get();
+
+  if(clk != CAL_clk || cycles < CAL_min || cycles > CAL_max) {
+    CAL_clk   = clk;                        // (re)start with this frame
+    CAL_min   = CAL_nominal[clk] - CAL_nominal[clk] / 16;
+    CAL_max   = CAL_nominal[clk] + CAL_nominal[clk] / 16;
+    CAL_sum   = 0;
+    CAL_count = CAL_FRAMES;                 // stays running if clock too slow
+    return;
+  }
+
+  CAL_sum += cycles;
+  if(!--CAL_count) CAL_done = 1;            // all frames measured
+}
@@ -0,0 +1,43 @@
+// ===================================================================================
+// Oscillator Calibration Functions for CH551, CH552 and CH554
+// ===================================================================================
+//
+// The internal RC oscillator is only accurate to a few percent, while the USB host
+// sends a Start-of-Frame packet (SOF) exactly every 1ms. The number of system clock
+// cycles between SOFs is counted with timer2 and averaged over CAL_FRAMES frames.
+// The CH55x has no oscillator trim register, so instead the delay constants used 
+// by DLY_ms() are corrected with the measured deviation. The measurement runs in 
+// the background and is repeated every CAL_INTERVAL ms to follow temperature drift.
+//
+// Functions available:
+// --------------------
+// CAL_init()               start cycle counter and measure delay loops
+// CAL_start()              start a new SOF measurement
+// CAL_update()             evaluate measurement, must be called every 1ms tick
+// CAL_SOF()                SOF handler, must be called by the SOF interrupt
+//
+// Results:
+// --------
+// CAL_error                deviation of system clock from nominal in ppm
+// CAL_cycles               measured system clock cycles per ms
+// CAL_clock                clock selection (CLK_xxx) of the measurement
+// CAL_valid                at least one measurement finished
+//
+// Timer2 is used as cycle counter (see CYC_start() in system.h).
+
+#pragma once
+#include <stdint.h>
+
+#define CAL_FRAMES    16                    // number of frames to average (2^n)
+#define CAL_INTERVAL  10000                 // time between measurements in ms
+
+extern __xdata int16_t  CAL_error;          // clock deviation in ppm
+extern __xdata uint16_t CAL_cycles;         // measured cycles per ms
+extern __xdata uint8_t  CAL_clock;          // clock selection of measurement
+extern __bit CAL_valid;                     // measurement available
+extern __code uint16_t CAL_nominal[];       // nominal cycles per ms, index: CLK_get()
+
+void CAL_init(void);                        // start counter, measure delay loops
+void CAL_start(void);                       // start new measurement
+void CAL_update(void);                      // evaluate measurement (every tick)
+void CAL_SOF(void);                         // SOF handler (USB interrupt)
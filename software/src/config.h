@@ -13,15 +13,93 @@
 #define PIN_ENC_B           P30         // pin connected to rotary encoder B
 #define PIN_ENC_SW          P33         // pin connected to rotary encoder switch
 
+// System clock scaling (CLK_24MHZ, CLK_16MHZ or CLK_12MHZ, see system.h)
+// USB full-speed needs at least 12 MHz, so CLK_IDLE must not go below CLK_12MHZ.
+#define CLK_ACTIVE          CLK_24MHZ   // clock for input, macros and LED frames
+#define CLK_IDLE            CLK_12MHZ   // clock when there is nothing to do
+#define CLK_IDLE_TIME       200         // time without input before slowing down in ms
+
+// Input debouncing (lock-out time after an accepted edge)
+#define KEY_DEBOUNCE        5           // keys and encoder switch in ms
+#define ENC_DEBOUNCE        1           // rotary encoder in ms
+
 // NeoPixel configuration
 #define NEO_COUNT           3           // number of pixels in the string
 #define NEO_GRB                         // type of pixel: NEO_GRB or NEO_RGB
+#define NEO_FRAME_TIME      20          // time between NeoPixel frames in ms
+
+// Time to wait for the host to resume the bus after remote wakeup, before the
+// device goes back to sleep and may signal again (max 255)
+#define USB_WAKE_TIMEOUT    50          // in ms
+
+// Task scheduler
+#define TASK_COUNT          7           // number of task slots
+
+// HID reports waiting for EP1 (macros), sent one per tick by HID_step()
+#define HID_QUEUE_SIZE      64          // queue size in bytes (power of 2, max 128)
+#define HID_QUEUE_WAIT      50          // max wait for room in a full queue in ms
+
+// Section profiler (cycle statistics as feature report, see prof.h)
+//#define PROF_ENABLE                   // uncomment to compile in the profiler
+
+// Input event trace (ring buffer read as feature report, see trace.h)
+//#define TRACE_ENABLE                  // uncomment to compile in the trace
+#define TRACE_SIZE          64          // entries in the ring (multiple of 16, max 240)
+
+// USB MIDI interface (see midi.h): keys send notes, the encoder a control change,
+// incoming control changes MIDI_LED_CC.. set the NeoPixel colors
+//#define MIDI_ENABLE                   // uncomment to add the MIDI interface
+#define MIDI_CHANNEL        0           // MIDI channel (0..15 = channel 1..16)
+#define MIDI_VELOCITY       100         // velocity of the notes
+#define MIDI_ENC_CC         16          // controller number of the encoder
+#define MIDI_ENC_STEP       1           // value change per encoder detent
+//#define MIDI_ENC_ABSOLUTE             // uncomment: absolute value (0..127) instead of
+                                        // relative (two's complement: 1 = +1, 127 = -1)
+#define MIDI_LED_CC         20          // controller number of the first NeoPixel
+
+// Raw HID interface (see raw.h): 64-byte packets in both directions on EP4 for host
+// applications, e.g. NeoPixel frames and input state. EP4 shares the buffer area
+// with EP0, the buffers of both MIDI_ENABLE and RAW_ENABLE do not fit below
+// TELE_ADDR, so only one of them can be enabled.
+//#define RAW_ENABLE                    // uncomment to add the raw HID interface
+
+// Driverless vendor interface: with RAW_WINUSB the raw interface is a vendor class
+// interface with bulk endpoints instead of HID. Microsoft OS and BOS descriptors
+// make Windows bind WinUSB to it, browsers can open it with WebUSB.
+//#define RAW_WINUSB                    // uncomment: vendor interface (needs RAW_ENABLE)
+//#define WEBUSB_URL        "github.com/wagiminator"  // landing page (https://)
 
 // USB device descriptor
 #define USB_VENDOR_ID       0x04b1      // VID
 #define USB_PRODUCT_ID      0x4657      // PID
 #define USB_DEVICE_VERSION  0x0100      // v1.0 (BCD-format)
 
+// Consumer keys which can be held at the same time (report ID + 2 bytes per key
+// must fit into the 8-byte EP1, so max. 3)
+#define CON_SLOTS           3
+
+// Mouse wheel (high-resolution steps per detent if the host enables the HID
+// Resolution Multiplier, see usb_composite.h)
+#define MOUSE_WHEEL_RES     4           // steps per detent (2..15)
+//#define ENC_SCROLL                    // uncomment: rotary encoder scrolls the wheel
+
+// Radial controller (Surface Dial style, see usb_composite.h)
+#define DIAL_STEP           100         // rotation per encoder detent in 1/10 degrees
+//#define ENC_DIAL                      // uncomment: rotary encoder is the dial
+
+// Gamepad mode (keys and encoder drive the gamepad, see JOY_map in the sketch)
+//#define JOY_MODE                      // uncomment to enable gamepad mode
+#define JOY_AXIS_STEP       512         // slider change per half encoder detent
+
+// Mouse keys (see mkey.h)
+#define MKEY_SPEED_INIT     100         // pointer speed at key press in pixels/s
+#define MKEY_SPEED_MAX      1200        // pointer speed after acceleration in pixels/s
+#define MKEY_ACCEL_TIME     1000        // time to reach max speed in ms (max 2040)
+#define MKEY_ACCEL_CURVE    2           // 0: constant, 1: linear, 2: quadratic
+#define MKEY_WHEEL_DELAY    300         // wheel key: delay before repeating in ms
+#define MKEY_WHEEL_RATE     50          // wheel key: time between repeats in ms
+//#define MKEY_LAYER                    // uncomment: encoder switch held = mouse layer
+
 // USB configuration descriptor
 #define USB_MAX_POWER_mA    150         // max power in mA 
 
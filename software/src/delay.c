@@ -3,68 +3,64 @@
 // ===================================================================================
 
 #include "delay.h"
-#include "ch554.h"
+#include "system.h"
+
+// Correction of the DLY_us() units per ms for CLK_IDLE..CLK_ACTIVE, set by cal.c
+__xdata int16_t DLY_msTrim[DLY_CLK_COUNT];
 
 // ===================================================================================
 // Delay in Units of us
 // ===================================================================================
+// The loop length is selected according to the current system clock, so the delay
+// stays correct when the clock is changed at runtime with CLK_set().
 void DLY_us(uint16_t n) {           // delay in us
-  #ifdef F_CPU
-    #if F_CPU <= 6000000
-      n >>= 2;
-    #endif
-    #if F_CPU <= 3000000
-      n >>= 2;
-    #endif
-    #if F_CPU <= 750000
-      n >>= 4;
-    #endif
-  #endif
+  uint8_t clk = CLK_get();
+
+  if(clk <= CLK_6MHZ)   n >>= 2;
+  if(clk <= CLK_3MHZ)   n >>= 2;
+  if(clk <= CLK_750KHZ) n >>= 4;
 
-  while(n) {                        // total = 12~13 Fsys cycles, 1uS @Fsys=12MHz
-    SAFE_MOD++;                     // 2 Fsys cycles, for higher Fsys, add operation here
-    #ifdef F_CPU
-      #if F_CPU >= 14000000
-        SAFE_MOD++;
-      #endif
-      #if F_CPU >= 16000000
-        SAFE_MOD++;
-      #endif
-      #if F_CPU >= 18000000
-        SAFE_MOD++;
-      #endif
-      #if F_CPU >= 20000000
-        SAFE_MOD++;
-      #endif
-      #if F_CPU >= 22000000
-        SAFE_MOD++;
-      #endif
-      #if F_CPU >= 24000000
-        SAFE_MOD++;
-      #endif
-      #if F_CPU >= 26000000
-        SAFE_MOD++;
-      #endif
-      #if F_CPU >= 28000000
-        SAFE_MOD++;
-      #endif
-      #if F_CPU >= 30000000
-        SAFE_MOD++;
-      #endif
-      #if F_CPU >= 32000000
-		    SAFE_MOD++;
-      #endif
-    #endif
-		n--;
+  switch(clk) {
+    case CLK_32MHZ:                 // total = 32 Fsys cycles, 1uS @Fsys=32MHz
+      while(n) {
+        SAFE_MOD++; SAFE_MOD++; SAFE_MOD++; SAFE_MOD++;
+        SAFE_MOD++; SAFE_MOD++; SAFE_MOD++; SAFE_MOD++;
+        SAFE_MOD++; SAFE_MOD++; SAFE_MOD++;
+        n--;
+      }
+      break;
+    case CLK_24MHZ:                 // total = 24 Fsys cycles, 1uS @Fsys=24MHz
+      while(n) {
+        SAFE_MOD++; SAFE_MOD++; SAFE_MOD++; SAFE_MOD++;
+        SAFE_MOD++; SAFE_MOD++; SAFE_MOD++;
+        n--;
+      }
+      break;
+    case CLK_16MHZ:                 // total = 16 Fsys cycles, 1uS @Fsys=16MHz
+      while(n) {
+        SAFE_MOD++; SAFE_MOD++; SAFE_MOD++;
+        n--;
+      }
+      break;
+    default:                        // total = 12~13 Fsys cycles, 1uS @Fsys=12MHz
+      while(n) {
+        SAFE_MOD++;                 // 2 Fsys cycles
+        n--;
+      }
+      break;
   }
 }
 
 // ===================================================================================
 // Delay in Units of ms
 // ===================================================================================
+// The units per ms are corrected by the oscillator calibration, so long delays
+// follow the real clock (USB SOF) instead of the nominal one.
 void DLY_ms(uint16_t n) {           // delay in ms
+  uint8_t  clk   = CLK_get();
+  uint16_t count = DLY_msCount(clk);
   while(n) {
-    DLY_us(1000);
+    DLY_us(count);
     n--;
   }
 }
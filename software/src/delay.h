@@ -4,10 +4,20 @@
 
 #pragma once
 #include <stdint.h>
+#include "config.h"
+#include "system.h"
 
 void DLY_us(uint16_t n);   // delay in units of us
 void DLY_ms(uint16_t n);   // delay in units of ms
 
+// The clocks the firmware runs at (CLK_IDLE..CLK_ACTIVE) are trimmed by the
+// oscillator calibration, all others use the nominal 1000 units per ms
+#define DLY_CLK_COUNT     (CLK_ACTIVE - CLK_IDLE + 1)
+#define DLY_msCount(clk)  ((clk) >= CLK_IDLE && (clk) <= CLK_ACTIVE ? \
+                           1000 + DLY_msTrim[(clk) - CLK_IDLE] : 1000)
+
+extern __xdata int16_t DLY_msTrim[DLY_CLK_COUNT];  // correction of DLY_us() units per ms
+
 // Delay clock cycles (max. 1039)
 // (need to find a smarter way...)
 #define DLY_cycles(n)               \
@@ -95,6 +105,7 @@ inline void _delay_cycles_11(void) {
 }
 
 inline void _delay_cycles_12(void) {
+  #ifdef __SDCC
   __asm
     push a
     push b
@@ -102,6 +113,7 @@ inline void _delay_cycles_12(void) {
     pop  b
     pop  a
   __endasm;
+  #endif
 }
 
 inline void _delay_cycles_13(void) {
@@ -120,6 +132,7 @@ inline void _delay_cycles_15(void) {
 }
 
 inline void _delay_cycles_16(void) {
+  #ifdef __SDCC
   __asm
     push a
     push b
@@ -128,6 +141,7 @@ inline void _delay_cycles_16(void) {
     pop  b
     pop  a
   __endasm;
+  #endif
 }
 
 inline void _delay_cycles_17(void) {
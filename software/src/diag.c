@@ -0,0 +1,96 @@
+// ===================================================================================
+// Diagnostics over HID Feature Reports for CH551, CH552 and CH554
+// ===================================================================================
+
+#include "diag.h"
+#include "usb_hid.h"
+#include "system.h"
+#include "delay.h"
+#include "cal.h"
+#include "lat.h"
+#include "prof.h"
+#include "trace.h"
+#include "tele.h"
+
+volatile __bit DIAG_bootRequest = 0;        // host requested bootloader
+
+// ===================================================================================
+// Fill Feature Report Buffer (called by USB interrupt)
+// ===================================================================================
+// Returns the length of the report including the ID or 0xFF if not supported.
+uint8_t DIAG_getFeature(uint8_t id) {
+  uint8_t  clk, i;
+  uint16_t count;
+  __xdata uint8_t *ptr;
+
+  HID_featureBuf[0] = id;
+  switch(id) {
+    case DIAG_REPORT_CAL:
+      clk   = CAL_valid ? CAL_clock : 0xFF;
+      count = DLY_msCount(clk);
+      HID_featureBuf[1] = (uint8_t)CAL_error;
+      HID_featureBuf[2] = (uint16_t)CAL_error >> 8;
+      HID_featureBuf[3] = (uint8_t)CAL_cycles;
+      HID_featureBuf[4] = CAL_cycles >> 8;
+      HID_featureBuf[5] = clk;
+      HID_featureBuf[6] = (uint8_t)count;
+      HID_featureBuf[7] = count >> 8;
+      return 8;
+
+    case DIAG_REPORT_LAT:
+      ptr = HID_featureBuf + 1;
+      for(i=0; i<LAT_BUCKETS; i++) {
+        *ptr++ = (uint8_t)LAT_hist[i];
+        *ptr++ = LAT_hist[i] >> 8;
+      }
+      *ptr++ = (uint8_t)LAT_max;
+      *ptr++ = LAT_max >> 8;
+      *ptr++ = (uint8_t)LAT_last;
+      *ptr   = LAT_last >> 8;
+      return 1 + 2 * LAT_BUCKETS + 4;
+
+    #ifdef PROF_ENABLE
+    case DIAG_REPORT_PROF:
+      PROF_report.id = id;
+      HID_featurePtr = (__xdata uint8_t *)&PROF_report;   // send statistics directly
+      return sizeof(PROF_report);
+    #endif
+
+    #ifdef TRACE_ENABLE
+    case DIAG_REPORT_TRACE:
+      return TRACE_getChunk(HID_featureBuf);
+    #endif
+
+    case DIAG_REPORT_TELE:
+      TELE_data.id = id;
+      HID_featurePtr = (__xdata uint8_t *)&TELE_data;     // send block directly
+      return TELE_REPORT_LEN;
+
+    default:
+      return 0xFF;                          // unknown report
+  }
+}
+
+// ===================================================================================
+// Handle Feature Report from Host (called by USB interrupt)
+// ===================================================================================
+// The report including the ID is in HID_featureBuf, unknown reports are ignored.
+void DIAG_setFeature(uint8_t id, uint8_t len) {
+  if(len < 2) return;                       // no command byte
+  switch(id) {
+    #ifdef TRACE_ENABLE
+    case DIAG_REPORT_TRACE:
+      TRACE_command(HID_featureBuf[1]);
+      break;
+    #endif
+
+    case DIAG_REPORT_BOOT:                  // key against accidental requests
+      if( (len >= 5) && (HID_featureBuf[1] == 'B') && (HID_featureBuf[2] == 'O')
+        && (HID_featureBuf[3] == 'O') && (HID_featureBuf[4] == 'T') )
+        DIAG_bootRequest = 1;               // taken by the main loop
+      break;
+
+    default:
+      break;
+  }
+}
@@ -0,0 +1,66 @@
+// ===================================================================================
+// Diagnostics over HID Feature Reports for CH551, CH552 and CH554
+// ===================================================================================
+//
+// Internal measurements can be read by the host as HID feature reports of the
+// vendor-defined collection (usage page 0xFF00) with tools/diag.py. All values 
+// are little-endian. The report IDs must match the report descriptor.
+//
+// Report 0x10 - oscillator calibration (7 bytes + ID):
+//   int16   clock deviation from nominal in ppm
+//   uint16  measured system clock cycles per ms
+//   uint8   clock selection of the measurement (CLK_xxx, 0xFF = not measured yet)
+//   uint16  DLY_us() units per ms at this clock
+//
+// Report 0x11 - input-to-report latency (36 bytes + ID, see lat.h):
+//   uint16  number of measurements per bucket, 16 logarithmic buckets
+//   uint16  longest latency in us
+//   uint16  latest latency in us
+//
+// Report 0x12 - section profiler (120 bytes + ID, only with PROF_ENABLE, see prof.h):
+//   10 sections, each:
+//   uint32  number of runs
+//   uint32  total cycles
+//   uint16  shortest run in cycles
+//   uint16  longest run in cycles
+//
+// Report 0x13 - input event trace (68 bytes + ID, only with TRACE_ENABLE, see trace.h):
+//   get: next chunk of the ring, the chunk index advances with every read
+//   uint8   flags: bit 0 = frozen, bit 1 = ring was filled (oldest entry at head)
+//   uint8   entries in the ring (TRACE_SIZE)
+//   uint8   head: next entry to write
+//   uint8   index of this chunk
+//   16 entries (uint16 timestamp in ms, uint8 type, uint8 data)
+//   set: first byte is the command (TRACE_CMD_RUN, TRACE_CMD_FREEZE)
+//
+// Report 0x14 - USB transport health telemetry (21 bytes + ID, see tele.h):
+//   uint8   cause of the last reset (0 = power-on, 1 = software, 2 = watchdog, 3 = pin)
+//   uint16  starts since power-on
+//   uint16  watchdog resets
+//   uint16  software and RST pin resets
+//   uint16  USB bus resets
+//   uint16  USB bus suspends
+//   uint16  stalled SETUP requests
+//   uint16  reports dropped (host sleeping or report queue full)
+//   uint32  EP1 busy-wait iterations
+//   uint16  mouse and gamepad updates merged into a later report
+//
+// Report 0x15 - bootloader entry (4 bytes + ID, set only):
+//   "BOOT" (0x42 0x4F 0x4F 0x54) sets DIAG_bootRequest, the application then
+//   releases all keys, switches off the NeoPixels and jumps to the bootloader
+//   (tools/chprog.py -r), other values are ignored
+
+#pragma once
+#include <stdint.h>
+
+#define DIAG_REPORT_CAL     0x10            // oscillator calibration
+#define DIAG_REPORT_LAT     0x11            // input-to-report latency
+#define DIAG_REPORT_PROF    0x12            // section profiler
+#define DIAG_REPORT_TRACE   0x13            // input event trace
+#define DIAG_REPORT_TELE    0x14            // USB transport health telemetry
+#define DIAG_REPORT_BOOT    0x15            // bootloader entry
+
+extern volatile __bit DIAG_bootRequest;     // host requested bootloader
+
+uint8_t DIAG_getFeature(uint8_t id);        // fill feature buffer, return length
+void DIAG_setFeature(uint8_t id, uint8_t len);  // report from host in feature buffer
@@ -0,0 +1,70 @@
+// ===================================================================================
+// Input-to-Report Latency Measurement for CH551, CH552 and CH554
+// ===================================================================================
+
+#include "lat.h"
+#include "system.h"
+#include "tick.h"
+#include "cal.h"
+#include "usb_hid.h"
+
+__xdata uint16_t LAT_hist[LAT_BUCKETS];     // histogram
+__xdata uint16_t LAT_max  = 0;              // longest latency in us
+__xdata uint16_t LAT_last = 0;              // latest latency in us
+
+__xdata uint16_t LAT_cycles;                // cycle counter at edge
+__xdata uint16_t LAT_ms;                    // tick counter at edge
+__bit LAT_pending = 0;                      // edge seen, no report queued yet
+__bit LAT_armed   = 0;                      // report queued, waiting for ACK
+
+// ===================================================================================
+// Start Measurement (Input Edge accepted by Scanner)
+// ===================================================================================
+void LAT_edge(void) {
+  if(LAT_pending || LAT_armed) return;      // measurement already running
+  LAT_cycles  = CYC_read();
+  LAT_ms      = TICK_millis();
+  LAT_pending = 1;
+}
+
+// ===================================================================================
+// Report Queued (before EP1 is armed, so the ACK cannot come first)
+// ===================================================================================
+void LAT_queued(void) {
+  if(!LAT_pending) return;
+  LAT_pending = 0;
+  LAT_armed   = 1;
+}
+
+// ===================================================================================
+// End of Tick (after all reports of the tick were queued)
+// ===================================================================================
+void LAT_drop(void) {
+  if(LAT_pending && !HID_busy()) LAT_pending = 0;  // edge sent no report
+}
+
+// ===================================================================================
+// Report fetched by Host (EP1 IN interrupt)
+// ===================================================================================
+void LAT_acked(void) {
+  uint16_t cycles, ms, us;
+  uint8_t  clk, i;
+
+  if(!LAT_armed) return;
+  LAT_armed = 0;
+  cycles = CYC_read() - LAT_cycles;
+  ms     = TICK_ms - LAT_ms;
+  clk    = CLK_get();
+
+  // The 16-bit cycle counter covers at least 2ms (at up to 32 MHz)
+  if(ms < 2 && clk >= CLK_12MHZ) us = cycles / (CAL_nominal[clk] / 1000);
+  else if(ms < 65)               us = ms * 1000;
+  else                           us = 0xFFFF;
+
+  // Bucket is the number of significant bits
+  LAT_last = us;
+  if(us > LAT_max) LAT_max = us;
+  for(i=0; us; i++) us >>= 1;
+  if(i >= LAT_BUCKETS) i = LAT_BUCKETS - 1;
+  if(LAT_hist[i] != 0xFFFF) LAT_hist[i]++;
+}
@@ -0,0 +1,46 @@
+// ===================================================================================
+// Input-to-Report Latency Measurement for CH551, CH552 and CH554
+// ===================================================================================
+//
+// Measures the time from the input scan which accepts an edge until the host has
+// fetched (ACKed) the first report queued after it. Both ends are timestamped with
+// the timer2 cycle counter (see CYC_start() in system.h), longer intervals fall
+// back to the millisecond tick. The results are collected in a histogram with
+// logarithmic buckets, which can be read as a feature report (see diag.h).
+//
+// The scan runs once per tick, so the electrical edge happened up to 1ms before
+// the measurement starts.
+//
+// Functions available:
+// --------------------
+// LAT_edge()               input edge accepted by the scanner (start measurement)
+// LAT_queued()             report queued, must be called before EP1 is armed
+// LAT_acked()              report fetched by host, called by the EP1 IN interrupt
+// LAT_drop()               end of tick, discards the edge if it queued no report
+//
+// Not every edge sends a report (key release without action, half a detent, MIDI
+// or raw HID inputs). LAT_drop() at the end of each tick discards such an edge
+// unless a report is still waiting for EP1 (see HID_busy()), so that a later
+// unrelated report is not measured against it.
+//
+// Results:
+// --------
+// LAT_hist[i]              number of measurements per bucket (saturating):
+//                          bucket 0: 0us, bucket i: 2^(i-1)..2^i-1 us,
+//                          bucket 15: 16384us and longer
+// LAT_max                  longest latency in us
+// LAT_last                 latest latency in us
+
+#pragma once
+#include <stdint.h>
+
+#define LAT_BUCKETS   16                    // number of histogram buckets
+
+extern __xdata uint16_t LAT_hist[LAT_BUCKETS];  // histogram
+extern __xdata uint16_t LAT_max;            // longest latency in us
+extern __xdata uint16_t LAT_last;           // latest latency in us
+
+void LAT_edge(void);                        // start measurement
+void LAT_queued(void);                      // report queued
+void LAT_acked(void);                       // report fetched by host
+void LAT_drop(void);                        // end of tick: discard edge without report
@@ -0,0 +1,98 @@
+// ===================================================================================
+// USB MIDI Functions for CH551, CH552 and CH554
+// ===================================================================================
+
+#include "midi.h"
+
+#ifdef MIDI_ENABLE
+
+#include "ch554.h"
+#include "usb_handler.h"
+
+#define MIDI_OUT_buffer     (EP3_buffer)        // packets from host
+#define MIDI_IN_buffer      (EP3_buffer + 64)   // packets to host
+
+__xdata uint8_t MIDI_queue[MIDI_QUEUE_SIZE];    // events not sent yet
+uint8_t MIDI_queueLen = 0;                      // bytes in queue
+uint8_t MIDI_rxLen = 0;                         // bytes in OUT buffer
+uint8_t MIDI_rxPos = 0;                         // next event to read
+volatile __bit MIDI_busy = 0;                   // IN packet not fetched yet
+
+// ===================================================================================
+// Front End Functions
+// ===================================================================================
+
+// Queue channel message (dropped if the host is sleeping or the queue is full)
+void MIDI_send(uint8_t cin, uint8_t d1, uint8_t d2) {
+  __xdata uint8_t *ptr;
+  if(USB_suspendFlag || (MIDI_queueLen > MIDI_QUEUE_SIZE - 4)) return;
+  ptr = MIDI_queue + MIDI_queueLen;
+  *ptr++ = cin;                                 // cable 0
+  *ptr++ = (cin << 4) | MIDI_CHANNEL;           // status
+  *ptr++ = d1 & 0x7F;
+  *ptr   = d2 & 0x7F;
+  MIDI_queueLen += 4;
+}
+
+// Send all queued events in one packet (call once per frame)
+void MIDI_flush(void) {
+  uint8_t i;
+  if(!MIDI_queueLen || MIDI_busy) return;       // nothing to send or EP3 busy
+  for(i=0; i<MIDI_queueLen; i++) MIDI_IN_buffer[i] = MIDI_queue[i];
+  UEP3_T_LEN = MIDI_queueLen;
+  MIDI_queueLen = 0;
+  MIDI_busy = 1;
+  UEP3_CTRL = (UEP3_CTRL & ~MASK_UEP_T_RES) | UEP_T_RES_ACK;  // upload data and respond ACK
+}
+
+// Next received event, the host can send the next packet when all are read
+__xdata uint8_t *MIDI_read(void) {
+  __xdata uint8_t *event;
+  while(MIDI_rxPos < MIDI_rxLen) {
+    event = MIDI_OUT_buffer + MIDI_rxPos;
+    MIDI_rxPos += 4;
+    if(event[0]) return event;                  // skip padding
+  }
+  if(MIDI_rxLen) {                              // packet done: receive next one
+    MIDI_rxLen = 0;
+    UEP3_CTRL = (UEP3_CTRL & ~MASK_UEP_R_RES) | UEP_R_RES_ACK;
+  }
+  return 0;
+}
+
+// ===================================================================================
+// USB Handler Functions
+// ===================================================================================
+
+// Setup endpoint 3 (OUT buffer at EP3_ADDR, IN buffer 64 bytes above)
+void MIDI_setup(void) {
+  UEP3_DMA    = EP3_ADDR;                       // EP3 data transfer address
+  UEP2_3_MOD |= bUEP3_RX_EN | bUEP3_TX_EN;      // EP3 RX and TX enable
+  MIDI_reset();
+}
+
+// Reset endpoint 3
+void MIDI_reset(void) {
+  UEP3_CTRL     = bUEP_AUTO_TOG | UEP_T_RES_NAK | UEP_R_RES_ACK;
+  UEP3_T_LEN    = 0;
+  MIDI_busy     = 0;
+  MIDI_rxLen    = 0;
+  MIDI_rxPos    = 0;
+}
+
+// Endpoint 3 IN handler (packet fetched by host)
+void MIDI_EP3_IN(void) {
+  UEP3_T_LEN = 0;
+  UEP3_CTRL = (UEP3_CTRL & ~MASK_UEP_T_RES) | UEP_T_RES_NAK;  // default NAK
+  MIDI_busy = 0;
+}
+
+// Endpoint 3 OUT handler (packet from host, NAK until read by MIDI_read)
+void MIDI_EP3_OUT(void) {
+  if(!U_TOG_OK) return;                         // out of sync: ignore packet
+  MIDI_rxLen = USB_RX_LEN & 0xFC;               // whole events only
+  MIDI_rxPos = 0;
+  if(MIDI_rxLen) UEP3_CTRL = (UEP3_CTRL & ~MASK_UEP_R_RES) | UEP_R_RES_NAK;
+}
+
+#endif
@@ -0,0 +1,51 @@
+// ===================================================================================
+// USB MIDI Functions for CH551, CH552 and CH554
+// ===================================================================================
+//
+// USB MIDI 1.0 streaming interface on bulk endpoint 3 (64 bytes each direction),
+// added to the composite device if MIDI_ENABLE is defined in config.h. Outgoing
+// events are collected in a queue and MIDI_flush() sends all of them in one packet
+// (up to 16 events) once per frame, so a fast spinning encoder does not need one
+// packet per event. Nothing blocks: if the host does not read the endpoint (no
+// application has the port open), the queue fills up and new events are dropped.
+//
+// Received packets are held (endpoint NAKs) until the application has read all
+// events with MIDI_read().
+//
+// Functions available:
+// --------------------
+// MIDI_noteOn(note, vel)   queue Note On on MIDI_CHANNEL
+// MIDI_noteOff(note)       queue Note Off on MIDI_CHANNEL
+// MIDI_control(cc, value)  queue Control Change on MIDI_CHANNEL
+// MIDI_flush()             send queued events, call every tick
+// MIDI_read()              pointer to next received event (4 bytes) or 0
+//
+// Event packets (4 bytes):
+// ------------------------
+// byte 0: cable number (bits 4-7) and code index number (MIDI_CIN_xxx)
+// byte 1: MIDI status (message type | channel), bytes 2-3: MIDI data
+
+#pragma once
+#include <stdint.h>
+#include "config.h"
+
+// Code index numbers (= message type for channel messages)
+#define MIDI_CIN_NOTE_OFF   0x08
+#define MIDI_CIN_NOTE_ON    0x09
+#define MIDI_CIN_CONTROL    0x0B
+
+#define MIDI_QUEUE_SIZE     64              // bytes (16 events, one packet)
+
+#ifdef MIDI_ENABLE
+
+void MIDI_setup(void);                      // setup endpoint 3 (USB init)
+void MIDI_reset(void);                      // reset endpoint 3 (bus reset)
+void MIDI_send(uint8_t cin, uint8_t d1, uint8_t d2);  // queue channel message
+void MIDI_flush(void);                      // send queued events (every tick)
+__xdata uint8_t *MIDI_read(void);           // next received event or 0
+
+#define MIDI_noteOn(note, vel)  MIDI_send(MIDI_CIN_NOTE_ON,  note, vel)
+#define MIDI_noteOff(note)      MIDI_send(MIDI_CIN_NOTE_OFF, note, 0)
+#define MIDI_control(cc, value) MIDI_send(MIDI_CIN_CONTROL,  cc, value)
+
+#endif
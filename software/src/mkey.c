@@ -0,0 +1,101 @@
+// ===================================================================================
+// Mouse Keys for CH551, CH552 and CH554
+// ===================================================================================
+
+#include "mkey.h"
+#include "usb_composite.h"
+
+#if MKEY_ACCEL_TIME > 2040
+#error "MKEY_ACCEL_TIME must not exceed 2040 ms"
+#endif
+
+#define MKEY_RAMP_SHIFT 3                   // speed is recalculated every 8ms
+#define MKEY_RAMP_STEPS (MKEY_ACCEL_TIME >> MKEY_RAMP_SHIFT)
+
+uint8_t  MKEY_keys  = 0;                    // held directions (MKEY_xxx)
+uint16_t MKEY_time  = 0;                    // time since pointer started in ms
+uint16_t MKEY_speed = 0;                    // pointer speed in pixels/s
+uint16_t MKEY_dist  = 0;                    // distance not moved yet in 1/1000 pixels
+uint16_t MKEY_wheelTimer = 0;               // ms until next wheel step
+__bit    MKEY_wheelRepeat = 0;              // wheel is in repeat phase
+__bit    MKEY_dragged = 0;                  // drag lock active
+
+// ===================================================================================
+// Key Functions
+// ===================================================================================
+
+// Start moving in direction(s)
+void MKEY_press(uint8_t keys) {
+  if((keys & MKEY_MOVE) && !(MKEY_keys & MKEY_MOVE)) {  // pointer starts moving?
+    MKEY_time  = 0;
+    MKEY_speed = MKEY_SPEED_INIT;
+    MKEY_dist  = 1000;                      // first pixel right away
+  }
+  if((keys & MKEY_WHEEL) && !(MKEY_keys & MKEY_WHEEL)) {  // wheel starts scrolling?
+    MKEY_wheelTimer  = 0;                   // first step right away
+    MKEY_wheelRepeat = 0;
+  }
+  MKEY_keys |= keys;
+}
+
+// Stop moving in direction(s)
+void MKEY_release(uint8_t keys) {
+  MKEY_keys &= ~keys;
+}
+
+// Toggle drag lock
+void MKEY_dragLock(void) {
+  MKEY_dragged = !MKEY_dragged;
+  if(MKEY_dragged) MOUSE_press(MOUSE_BUTTON_LEFT);
+  else             MOUSE_release(MOUSE_BUTTON_LEFT);
+}
+
+// ===================================================================================
+// Motion (every tick)
+// ===================================================================================
+
+// Speed of the pointer after MKEY_time ms
+void MKEY_ramp(void) {
+#if MKEY_ACCEL_CURVE == 1 && MKEY_RAMP_STEPS
+  uint16_t n = MKEY_time >> MKEY_RAMP_SHIFT;
+  MKEY_speed = MKEY_SPEED_INIT + (uint16_t)((uint32_t)(MKEY_SPEED_MAX - MKEY_SPEED_INIT)
+             * n / MKEY_RAMP_STEPS);
+#elif MKEY_ACCEL_CURVE == 2 && MKEY_RAMP_STEPS
+  uint16_t n = MKEY_time >> MKEY_RAMP_SHIFT;
+  MKEY_speed = MKEY_SPEED_INIT + (uint16_t)((uint32_t)(MKEY_SPEED_MAX - MKEY_SPEED_INIT)
+             * (n * n) / ((uint32_t)MKEY_RAMP_STEPS * MKEY_RAMP_STEPS));
+#elif MKEY_ACCEL_CURVE
+  MKEY_speed = MKEY_SPEED_MAX;
+#endif
+}
+
+// Integrate pointer motion and wheel repeat, add them to the mouse report
+void MKEY_update(void) {
+  uint8_t step;
+
+  // Pointer: speed in pixels/s is the distance in 1/1000 pixels per ms
+  if(MKEY_keys & MKEY_MOVE) {
+    if(MKEY_time < MKEY_ACCEL_TIME) {
+      MKEY_time++;
+      if(!(MKEY_time & ((1 << MKEY_RAMP_SHIFT) - 1))) MKEY_ramp();
+    }
+    MKEY_dist += MKEY_speed;
+    for(step=0; MKEY_dist >= 1000; step++) MKEY_dist -= 1000;
+    if(step) MOUSE_addMove(
+      (MKEY_keys & MKEY_RIGHT ? step : 0) - (MKEY_keys & MKEY_LEFT ? step : 0),
+      (MKEY_keys & MKEY_DOWN  ? step : 0) - (MKEY_keys & MKEY_UP   ? step : 0) );
+  }
+
+  // Wheel: one detent at once, repeated while held
+  if(MKEY_keys & MKEY_WHEEL) {
+    if(!MKEY_wheelTimer) {
+      if(MKEY_keys & MKEY_WHEEL_UP)    MOUSE_wheelHiRes( MOUSE_WHEEL_RES);
+      if(MKEY_keys & MKEY_WHEEL_DOWN)  MOUSE_wheelHiRes(-MOUSE_WHEEL_RES);
+      if(MKEY_keys & MKEY_PAN_RIGHT)   MOUSE_panHiRes( MOUSE_WHEEL_RES);
+      if(MKEY_keys & MKEY_PAN_LEFT)    MOUSE_panHiRes(-MOUSE_WHEEL_RES);
+      MKEY_wheelTimer  = MKEY_wheelRepeat ? MKEY_WHEEL_RATE : MKEY_WHEEL_DELAY;
+      MKEY_wheelRepeat = 1;
+    }
+    MKEY_wheelTimer--;
+  }
+}
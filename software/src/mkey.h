@@ -0,0 +1,50 @@
+// ===================================================================================
+// Mouse Keys for CH551, CH552 and CH554
+// ===================================================================================
+//
+// Moves the mouse pointer and the wheels as long as keys are held. The pointer
+// starts with MKEY_SPEED_INIT and speeds up to MKEY_SPEED_MAX within
+// MKEY_ACCEL_TIME along the curve MKEY_ACCEL_CURVE (see config.h). Wheel keys
+// scroll one detent at once and repeat after MKEY_WHEEL_DELAY every
+// MKEY_WHEEL_RATE ms. Drag lock holds the left button until it is toggled again.
+//
+// MKEY_update() integrates the motion once per tick and adds it to the mouse
+// report, MOUSE_flush() sends it (at most one report per frame, see
+// usb_composite.h).
+//
+// Functions available:
+// --------------------
+// MKEY_press(keys)         start moving in direction(s) (MKEY_xxx)
+// MKEY_release(keys)       stop moving in direction(s), MKEY_ALL stops everything
+// MKEY_dragLock()          toggle drag lock (left button held)
+// MKEY_update()            integrate motion, call every tick before MOUSE_flush()
+//
+// Notes:
+// ------
+// - Opposite directions cancel each other out, diagonal motion moves both axes
+//   at full speed.
+// - The first step of a key press is sent at once, so a short tap moves the
+//   pointer by one pixel.
+
+#pragma once
+#include <stdint.h>
+#include "config.h"
+
+// Directions
+#define MKEY_UP             0x01            // pointer up
+#define MKEY_DOWN           0x02            // pointer down
+#define MKEY_LEFT           0x04            // pointer left
+#define MKEY_RIGHT          0x08            // pointer right
+#define MKEY_WHEEL_UP       0x10            // scroll up
+#define MKEY_WHEEL_DOWN     0x20            // scroll down
+#define MKEY_PAN_LEFT       0x40            // scroll left
+#define MKEY_PAN_RIGHT      0x80            // scroll right
+#define MKEY_ALL            0xFF            // all directions
+
+#define MKEY_MOVE           0x0F            // pointer directions
+#define MKEY_WHEEL          0xF0            // wheel directions
+
+void MKEY_press(uint8_t keys);              // start moving in direction(s)
+void MKEY_release(uint8_t keys);            // stop moving in direction(s)
+void MKEY_dragLock(void);                   // toggle drag lock
+void MKEY_update(void);                     // integrate motion (every tick)
@@ -9,7 +9,7 @@
 // PIN_NEO   - pin connected to DATA-IN of the pixel strip (via a ~330 ohms resistor).
 // NEO_GRB   - type of pixel: NEO_GRB or NEO_RGB
 // NEO_COUNT - total number of pixels
-// System clock frequency must be at least 6 MHz.
+// System clock must be 6, 12, 16 or 24 MHz, it can be changed at runtime.
 //
 // Further information:     https://github.com/wagiminator/ATtiny13-NeoController
 // 2023 by Stefan Wagner:   https://github.com/wagiminator
@@ -18,6 +18,7 @@
 // Libraries, Variables and Constants
 // ===================================================================================
 #include "neo.h"
+#include "system.h"
 
 #define NEOPIN PIN_asm(PIN_NEO)             // convert PIN_NEO for inline assembly
 __xdata uint8_t NEO_buffer[3 * NEO_COUNT];  // pixel buffer
@@ -31,50 +32,54 @@ __xdata uint8_t *ptr;                       // pixel buffer pointer
 // - T1H (HIGH-time for "1"-bit) must be min.  625ns
 // - TCT (total clock time) must be      min. 1150ns
 // The bit transmission loop takes 11 clock cycles.
-#if F_CPU == 24000000       // 24 MHz system clock
-  #define T1H_DELAY \
-    nop             \
-    nop             \
-    nop             \
-    nop             \
-    nop             \
-    nop             \
-    nop             \
-    nop             \
-    nop             \
-    nop             \
-    nop                     // 15 - 4 = 11 clock cycles for min 625ns
-  #define TCT_DELAY \
-    nop             \
-    nop             \
-    nop             \
-    nop             \
-    nop             \
-    nop                     // 28 - 11 - 11 = 6 clock cycles for min 1150ns
-#elif F_CPU == 16000000     // 16 MHz system clock
-  #define T1H_DELAY \
-    nop             \
-    nop             \
-    nop             \
-    nop             \
-    nop             \
-    nop                     // 10 - 4 = 6 clock cycles for min 625ns
-  #define TCT_DELAY \
-    nop             \
-    nop                     // 19 - 6 - 11 = 2 clock cycles for min 1150ns
-#elif F_CPU == 12000000     // 12 MHz system clock
-  #define T1H_DELAY \
-    nop             \
-    nop             \
-    nop             \
-    nop                     // 8 - 4 = 4 clock cycles for min 625ns
-  #define TCT_DELAY         // 14 - 4 - 11 < 0 clock cycles for min 1150ns
-#elif F_CPU == 6000000      // 13 MHz system clock
-  #define T1H_DELAY         // 4 - 4 = 0 clock cycles for min 625ns
-  #define TCT_DELAY         // 7 - 0 - 11 < 0 clock cycles for min 1150ns
-#else
-  #error Unsupported system clock frequency for NeoPixels!
-#endif
+// T1H gets one extra cycle at 16 and 24 MHz, where it would otherwise be exactly
+// at the limit and fail as soon as the RC oscillator runs a little fast.
+// 24 MHz system clock
+#define T1H_DELAY_24MHZ \
+  nop             \
+  nop             \
+  nop             \
+  nop             \
+  nop             \
+  nop             \
+  nop             \
+  nop             \
+  nop             \
+  nop             \
+  nop             \
+  nop                       // 16 - 4 = 12 clock cycles for min 625ns (+6%)
+#define TCT_DELAY_24MHZ \
+  nop             \
+  nop             \
+  nop             \
+  nop             \
+  nop             \
+  nop                       // 29 - 12 - 11 = 6 clock cycles for min 1150ns
+
+// 16 MHz system clock
+#define T1H_DELAY_16MHZ \
+  nop             \
+  nop             \
+  nop             \
+  nop             \
+  nop             \
+  nop             \
+  nop                       // 11 - 4 = 7 clock cycles for min 625ns (+10%)
+#define TCT_DELAY_16MHZ \
+  nop             \
+  nop                       // 20 - 7 - 11 = 2 clock cycles for min 1150ns
+
+// 12 MHz system clock
+#define T1H_DELAY_12MHZ \
+  nop             \
+  nop             \
+  nop             \
+  nop                       // 8 - 4 = 4 clock cycles for min 625ns
+#define TCT_DELAY_12MHZ     // 14 - 4 - 11 < 0 clock cycles for min 1150ns
+
+// 6 MHz system clock
+#define T1H_DELAY_6MHZ      // 4 - 4 = 0 clock cycles for min 625ns
+#define TCT_DELAY_6MHZ      // 7 - 0 - 11 < 0 clock cycles for min 1150ns
 
 // ===================================================================================
 // Send a Data Byte to the Pixels String
@@ -82,7 +87,60 @@ __xdata uint8_t *ptr;                       // pixel buffer pointer
 // This is the most time sensitive part. Outside of the function, it must be 
 // ensured that interrupts are disabled and that the time between the 
 // transmission of the individual bytes is less than the pixel's latch time.
-void NEO_sendByte(uint8_t data) { 
+// There is one transmission routine per supported system clock, the right one is
+// selected at runtime, so the clock can be changed with CLK_set() at any time.
+void NEO_sendByte_24MHz(uint8_t data) {
+  data;                 // stop unreferenced argument warning
+  __asm
+    .even
+    mov  r7, #8         ; 2 CLK - 8 bits to transfer
+    xch  a, dpl         ; 2 CLK - data byte -> accu
+    01$:
+    rlc  a              ; 1 CLK - data bit -> carry (MSB first)
+    setb NEOPIN         ; 2 CLK - NEO pin HIGH
+    mov  NEOPIN, c      ; 2 CLK - "0"-bit? -> NEO pin LOW now
+    T1H_DELAY_24MHZ     ; x CLK - TH1 delay
+    clr  NEOPIN         ; 2 CLK - "1"-bit? -> NEO pin LOW a little later
+    TCT_DELAY_24MHZ     ; y CLK - TCT delay
+    djnz r7, 01$        ; 2/4|5|6 CLK - repeat for all bits
+  __endasm;
+}
+
+void NEO_sendByte_16MHz(uint8_t data) {
+  data;                 // stop unreferenced argument warning
+  __asm
+    .even
+    mov  r7, #8         ; 2 CLK - 8 bits to transfer
+    xch  a, dpl         ; 2 CLK - data byte -> accu
+    01$:
+    rlc  a              ; 1 CLK - data bit -> carry (MSB first)
+    setb NEOPIN         ; 2 CLK - NEO pin HIGH
+    mov  NEOPIN, c      ; 2 CLK - "0"-bit? -> NEO pin LOW now
+    T1H_DELAY_16MHZ     ; x CLK - TH1 delay
+    clr  NEOPIN         ; 2 CLK - "1"-bit? -> NEO pin LOW a little later
+    TCT_DELAY_16MHZ     ; y CLK - TCT delay
+    djnz r7, 01$        ; 2/4|5|6 CLK - repeat for all bits
+  __endasm;
+}
+
+void NEO_sendByte_12MHz(uint8_t data) {
+  data;                 // stop unreferenced argument warning
+  __asm
+    .even
+    mov  r7, #8         ; 2 CLK - 8 bits to transfer
+    xch  a, dpl         ; 2 CLK - data byte -> accu
+    01$:
+    rlc  a              ; 1 CLK - data bit -> carry (MSB first)
+    setb NEOPIN         ; 2 CLK - NEO pin HIGH
+    mov  NEOPIN, c      ; 2 CLK - "0"-bit? -> NEO pin LOW now
+    T1H_DELAY_12MHZ     ; x CLK - TH1 delay
+    clr  NEOPIN         ; 2 CLK - "1"-bit? -> NEO pin LOW a little later
+    TCT_DELAY_12MHZ     ; y CLK - TCT delay
+    djnz r7, 01$        ; 2/4|5|6 CLK - repeat for all bits
+  __endasm;
+}
+
+void NEO_sendByte_6MHz(uint8_t data) {
   data;                 // stop unreferenced argument warning
   __asm
     .even
@@ -92,13 +150,22 @@ void NEO_sendByte(uint8_t data) {
     rlc  a              ; 1 CLK - data bit -> carry (MSB first)
     setb NEOPIN         ; 2 CLK - NEO pin HIGH
     mov  NEOPIN, c      ; 2 CLK - "0"-bit? -> NEO pin LOW now
-    T1H_DELAY           ; x CLK - TH1 delay
+    T1H_DELAY_6MHZ      ; x CLK - TH1 delay
     clr  NEOPIN         ; 2 CLK - "1"-bit? -> NEO pin LOW a little later
-    TCT_DELAY           ; y CLK - TCT delay
+    TCT_DELAY_6MHZ      ; y CLK - TCT delay
     djnz r7, 01$        ; 2/4|5|6 CLK - repeat for all bits
   __endasm;
 }
 
+void NEO_sendByte(uint8_t data) {
+  switch(CLK_get()) {
+    case CLK_24MHZ: NEO_sendByte_24MHz(data); break;
+    case CLK_16MHZ: NEO_sendByte_16MHz(data); break;
+    case CLK_12MHZ: NEO_sendByte_12MHz(data); break;
+    default:        NEO_sendByte_6MHz(data);  break;
+  }
+}
+
 // ===================================================================================
 // Write Buffer to Pixels
 // ===================================================================================
@@ -121,6 +188,17 @@ void NEO_clearAll(void) {
   NEO_update();
 }
 
+// ===================================================================================
+// Switch off all Pixels without touching the Buffer (restore with NEO_update)
+// ===================================================================================
+void NEO_blank(void) {
+  uint8_t i;
+  EA = 0;
+  for(i=3*NEO_COUNT; i; i--) NEO_sendByte(0);
+  EA = 1;
+  NEO_latch();
+}
+
 // ===================================================================================
 // Write Color to a Single Pixel in Buffer
 // ===================================================================================
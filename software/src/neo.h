@@ -9,7 +9,7 @@
 // PIN_NEO   - pin connected to DATA-IN of the pixel strip (via a ~330 ohms resistor).
 // NEO_GRB   - type of pixel: NEO_GRB or NEO_RGB
 // NEO_COUNT - total number of pixels
-// System clock frequency must be at least 6 MHz.
+// System clock must be 6, 12, 16 or 24 MHz, it can be changed at runtime.
 //
 // Further information:     https://github.com/wagiminator/ATtiny13-NeoController
 // 2023 by Stefan Wagner:   https://github.com/wagiminator
@@ -25,6 +25,7 @@
 
 void NEO_sendByte(uint8_t data);                                      // send a single byte to the pixels
 void NEO_clearAll(void);                                              // clear all pixels
+void NEO_blank(void);                                                 // switch off pixels, keep buffer
 void NEO_update(void);                                                // write buffer to pixels
 void NEO_writeColor(uint8_t pixel, uint8_t r, uint8_t g, uint8_t b);  // write color to pixel in buffer
 void NEO_writeHue(uint8_t pixel, uint8_t hue, uint8_t bright);        // hue (0..191), brightness (0..2)
@@ -0,0 +1,24 @@
+// ===================================================================================
+// Section Profiler for CH551, CH552 and CH554
+// ===================================================================================
+
+#include "prof.h"
+
+#ifdef PROF_ENABLE
+
+__xdata PROF_REPORT_DATA PROF_report;       // statistics of all sections
+__xdata uint16_t PROF_stamp[PROF_SECTIONS]; // cycle counter at section start
+
+// ===================================================================================
+// Add Measurement to Statistics of a Section
+// ===================================================================================
+// Reentrant, since it is called from the main loop and from interrupts.
+void PROF_add(uint8_t sec, uint16_t cycles) __reentrant {
+  __xdata PROF_SECTION *s = &PROF_report.section[sec];
+  if(!s->count || cycles < s->min) s->min = cycles;
+  if(cycles > s->max) s->max = cycles;
+  s->total += cycles;
+  s->count++;
+}
+
+#endif
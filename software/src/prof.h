@@ -0,0 +1,72 @@
+// ===================================================================================
+// Section Profiler for CH551, CH552 and CH554
+// ===================================================================================
+//
+// Measures how many system clock cycles named code sections take, using the timer2
+// cycle counter (see CYC_start() in system.h). For every section the number of
+// runs, the shortest, the longest and the total number of cycles are collected in
+// xdata. The host reads them as feature report (see diag.h).
+//
+// The profiler is only compiled in if PROF_ENABLE is defined in config.h, otherwise
+// the macros are empty and cost nothing.
+//
+// Macros available:
+// -----------------
+// PROF_start(sec)          start measurement of section sec (PROF_xxx)
+// PROF_stop(sec)           stop measurement and add it to the statistics
+//
+// Notes:
+// ------
+// - A section must not take more than 65535 cycles (2ms at 32 MHz).
+// - Sections in the main loop include the interrupts that happened meanwhile.
+// - Cycles are counted with the clock that was selected, the clock scaling changes
+//   the cycles per us.
+
+#pragma once
+#include <stdint.h>
+#include "config.h"
+
+// Sections
+#define PROF_USB_ISR        0               // USB interrupt (all endpoints)
+#define PROF_EP0_SETUP      1               // EP0 SETUP callback
+#define PROF_EP0_IN         2               // EP0 IN callback
+#define PROF_SOF            3               // SOF callback (tick, calibration)
+#define PROF_EP1_IN         4               // EP1 IN callback (report sent)
+#define PROF_EP2_OUT        5               // EP2 OUT callback (output report)
+#define PROF_DEBOUNCE       6               // input scan and debounce step
+#define PROF_MACRO          7               // macro actions of the scan
+#define PROF_NEO            8               // NeoPixel frame
+#define PROF_REPORT         9               // report enqueue (HID_sendReport)
+#define PROF_SECTIONS       10              // number of sections
+
+#ifdef PROF_ENABLE
+#include "system.h"
+
+// Statistics of a section (little-endian, sent as is to the host)
+typedef struct {
+  uint32_t count;                           // number of runs
+  uint32_t total;                           // sum of cycles
+  uint16_t min;                             // shortest run in cycles
+  uint16_t max;                             // longest run in cycles
+} PROF_SECTION;
+
+// Feature report: ID followed by the statistics of all sections
+typedef struct {
+  uint8_t      id;
+  PROF_SECTION section[PROF_SECTIONS];
+} PROF_REPORT_DATA;
+
+extern __xdata PROF_REPORT_DATA PROF_report;
+extern __xdata uint16_t PROF_stamp[PROF_SECTIONS];
+
+void PROF_add(uint8_t sec, uint16_t cycles) __reentrant;
+
+#define PROF_start(sec)   PROF_stamp[sec] = CYC_read()
+#define PROF_stop(sec)    PROF_add(sec, CYC_read() - PROF_stamp[sec])
+
+#else
+
+#define PROF_start(sec)
+#define PROF_stop(sec)
+
+#endif
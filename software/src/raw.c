@@ -0,0 +1,82 @@
+// ===================================================================================
+// USB Raw HID Functions for CH551, CH552 and CH554
+// ===================================================================================
+
+#include "raw.h"
+
+#ifdef RAW_ENABLE
+
+#include "ch554.h"
+#include "usb_handler.h"
+
+#define RAW_OUT_buffer      (EP4_buffer)        // packets from host
+#define RAW_IN_buffer       (EP4_buffer + 64)   // packets to host
+
+volatile __bit RAW_busy = 0;                    // IN packet not fetched yet
+volatile __bit RAW_received = 0;                // OUT packet not released yet
+
+// ===================================================================================
+// Front End Functions
+// ===================================================================================
+
+// IN buffer to fill, 0 if the host did not fetch the last packet or is sleeping
+__xdata uint8_t *RAW_buffer(void) {
+  if(RAW_busy || USB_suspendFlag) return 0;
+  return RAW_IN_buffer;
+}
+
+// Send the IN buffer (always RAW_SIZE bytes)
+void RAW_send(void) {
+  UEP4_T_LEN = RAW_SIZE;
+  RAW_busy = 1;
+  UEP4_CTRL = (UEP4_CTRL & ~MASK_UEP_T_RES) | UEP_T_RES_ACK;  // upload data and respond ACK
+}
+
+// Received packet, valid until RAW_release()
+__xdata uint8_t *RAW_read(void) {
+  return RAW_received ? RAW_OUT_buffer : 0;
+}
+
+// Packet read: receive next one
+void RAW_release(void) {
+  if(!RAW_received) return;
+  RAW_received = 0;
+  UEP4_CTRL = (UEP4_CTRL & ~MASK_UEP_R_RES) | UEP_R_RES_ACK;
+}
+
+// ===================================================================================
+// USB Handler Functions
+// ===================================================================================
+
+// Setup endpoint 4 (buffers follow EP0, see usb_descr.h)
+void RAW_setup(void) {
+  UEP4_1_MOD |= bUEP4_RX_EN | bUEP4_TX_EN;      // EP4 RX and TX enable
+  RAW_reset();
+}
+
+// Reset endpoint 4 (no auto toggle on EP4)
+void RAW_reset(void) {
+  UEP4_CTRL    = UEP_T_RES_NAK | UEP_R_RES_ACK;
+  UEP4_T_LEN   = 0;
+  RAW_busy     = 0;
+  RAW_received = 0;
+}
+
+// Endpoint 4 IN handler (packet fetched by host)
+void RAW_EP4_IN(void) {
+  UEP4_T_LEN = 0;
+  UEP4_CTRL = ((UEP4_CTRL ^ bUEP_T_TOG) & ~MASK_UEP_T_RES) | UEP_T_RES_NAK;  // default NAK
+  RAW_busy = 0;
+}
+
+// Endpoint 4 OUT handler (packet from host, NAK until released)
+void RAW_EP4_OUT(void) {
+  uint8_t i;
+  if(!U_TOG_OK) return;                         // out of sync: ignore packet
+  UEP4_CTRL ^= bUEP_R_TOG;                      // expect other DATA toggle next
+  for(i=USB_RX_LEN; i<RAW_SIZE; i++) RAW_OUT_buffer[i] = 0;  // pad short packet
+  RAW_received = 1;
+  UEP4_CTRL = (UEP4_CTRL & ~MASK_UEP_R_RES) | UEP_R_RES_NAK;
+}
+
+#endif
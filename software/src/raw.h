@@ -0,0 +1,48 @@
+// ===================================================================================
+// USB Raw HID Functions for CH551, CH552 and CH554
+// ===================================================================================
+//
+// Generic 64-byte data channel for host applications on interface RAW_INTERFACE,
+// added to the composite device if RAW_ENABLE is defined in config.h. The interface
+// has its own interrupt endpoint 4 in both directions (polled every 1ms), so the
+// application data does not go through EP0 control transfers and does not delay
+// the keyboard reports on EP1. The vendor usage page 0xFF60 lets host tools find
+// the interface with hidapi.
+//
+// With RAW_WINUSB the interface is vendor class with bulk endpoints instead. The
+// Microsoft OS descriptors (see usb_descr.c) bind WinUSB without a driver install,
+// libusb and WebUSB (navigator.usb) open it directly. The packets stay the same.
+//
+// Packets are 64 bytes without report ID, shorter packets from the host are padded
+// with zeros. What they contain is up to the application (see the RAW_CMD_xxx
+// protocol in macropad_plus.c). Nothing blocks: RAW_buffer() returns 0 while the
+// last packet was not fetched by the host yet, and a received packet is held
+// (endpoint NAKs) until RAW_release() is called.
+//
+// Functions available:
+// --------------------
+// RAW_buffer()             IN buffer to fill (64 bytes) or 0 if still busy
+// RAW_send()               send the filled IN buffer
+// RAW_read()               received packet (64 bytes) or 0
+// RAW_release()            packet read, the host can send the next one
+//
+// Notes:
+// ------
+// - EP4 has no automatic toggle of DATA0/DATA1, the handlers switch it.
+
+#pragma once
+#include <stdint.h>
+#include "config.h"
+
+#define RAW_SIZE            64              // packet size in bytes
+
+#ifdef RAW_ENABLE
+
+void RAW_setup(void);                       // setup endpoint 4 (USB init)
+void RAW_reset(void);                       // reset endpoint 4 (bus reset)
+__xdata uint8_t *RAW_buffer(void);          // IN buffer to fill or 0 if busy
+void RAW_send(void);                        // send filled IN buffer
+__xdata uint8_t *RAW_read(void);            // received packet or 0
+void RAW_release(void);                     // receive next packet
+
+#endif
@@ -1,13 +1,18 @@
 // ===================================================================================
-// Basic System Functions for CH551, CH552 and CH554                          * v1.3 *
+// Basic System Functions for CH551, CH552 and CH554                          * v1.5 *
 // ===================================================================================
 //
 // Functions available:
 // --------------------
 // CLK_config()             set system clock frequency according to F_CPU
+// CLK_set(clk)             set system clock frequency at runtime (clocks see below)
+// CLK_get()                get current system clock selection
 // CLK_external()           set external crystal as clock source
 // CLK_internal()           set internal oscillator as clock source
 //
+// CYC_start()              start timer2 as free-running system clock cycle counter
+// CYC_read()               read 16-bit cycle counter (wraps around)
+//
 // WDT_start()              start watchdog timer with full period
 // WDT_stop()               stop watchdog timer
 // WDT_reset()              reload watchdog timer with full period
@@ -47,6 +52,11 @@
 // WAKE_RST_disable()       disable wake-up by pin RST high level
 // WAKE_INT_disable()       disable wake-up by pin P3.2 edge or pin P3.3 low level
 //
+// System clocks for CLK_set():
+// -----------------------------
+// CLK_32MHZ, CLK_24MHZ, CLK_16MHZ, CLK_12MHZ, CLK_6MHZ, CLK_3MHZ, CLK_750KHZ, CLK_187KHZ
+// USB full-speed needs at least 12 MHz, NeoPixels work at 6, 12, 16 and 24 MHz.
+//
 // Wake-up from SLEEP sources:
 // ---------------------------
 // WAKE_USB                 wake-up by USB event
@@ -100,6 +110,27 @@ inline void CLK_config(void) {
   SAFE_MOD = 0x00;                              // terminate safe mode
 }
 
+#define CLK_32MHZ     0b111           // Fsys = Fpll / 3
+#define CLK_24MHZ     0b110           // Fsys = Fpll / 4
+#define CLK_16MHZ     0b101           // Fsys = Fpll / 6
+#define CLK_12MHZ     0b100           // Fsys = Fpll / 8
+#define CLK_6MHZ      0b011           // Fsys = Fpll / 16
+#define CLK_3MHZ      0b010           // Fsys = Fpll / 32
+#define CLK_750KHZ    0b001           // Fsys = Fpll / 128
+#define CLK_187KHZ    0b000           // Fsys = Fpll / 512
+
+#define CLK_get()     (CLOCK_CFG & MASK_SYS_CK_SEL)
+
+inline void CLK_set(uint8_t clk) {
+  __bit ea  = EA;
+  EA        = 0;                                // no interrupt between 0x55 and 0xAA
+  SAFE_MOD  = 0x55;
+  SAFE_MOD  = 0xAA;                             // enter safe mode
+  CLOCK_CFG = (CLOCK_CFG & ~MASK_SYS_CK_SEL) | clk; // select new system clock
+  SAFE_MOD  = 0x00;                             // terminate safe mode
+  EA        = ea;
+}
+
 inline void CLK_external(void) {
   SAFE_MOD = 0x55;
   SAFE_MOD = 0xAA;                              // enter safe mode
@@ -116,6 +147,38 @@ inline void CLK_inernal(void) {
   SAFE_MOD = 0x00;                              // terminate safe mode
 }
 
+// ===================================================================================
+// Cycle Counter (Timer2)
+// ===================================================================================
+// Timer2 counts Fsys cycles and wraps around every 65536 cycles (2ms @ 32MHz), so
+// differences of two readings give the exact number of cycles in between.
+inline void CYC_start(void) {
+  T2CON   = 0;                                  // timer, auto-reload on overflow
+  T2MOD  |= bTMR_CLK | bT2_CLK;                 // timer2 clock: Fsys
+  RCAP2L  = 0;                                  // reload value: 0
+  RCAP2H  = 0;
+  TR2     = 1;                                  // start timer2
+}
+
+// Read high byte before and after low byte to catch a carry in between
+inline uint16_t CYC_read(void) {
+  uint8_t hi, lo;
+  do {
+    hi = TH2;
+    lo = TL2;
+  } while(hi != TH2);
+  return ((uint16_t)hi << 8) | lo;
+}
+
+// ===================================================================================
+// Busy-Wait Hook
+// ===================================================================================
+// Called in loops which wait for an interrupt. Empty on the chip, the host 
+// simulation (sim/sim.h) uses it to run the bus model.
+#ifndef WAIT_hook
+#define WAIT_hook()
+#endif
+
 // ===================================================================================
 // Watchdog Timer
 // ===================================================================================
@@ -157,6 +220,7 @@ inline void RST_now(void) {
 // ===================================================================================
 // Bootloader
 // ===================================================================================
+#ifndef BOOT_now                                // can be replaced by host simulation
 inline void BOOT_now(void) {
   USB_CTRL = 0;
   EA       = 0;
@@ -165,11 +229,14 @@ inline void BOOT_now(void) {
     lcall #BOOT_LOAD_ADDR
   __endasm;
 }
+#endif
 
 // ===================================================================================
 // Sleep
 // ===================================================================================
+#ifndef SLEEP_now                               // can be replaced by host simulation
 #define SLEEP_now()   PCON |= PD
+#endif
 
 #define WAKE_USB      bWAK_BY_USB     // wake-up by USB event
 #define WAKE_RXD0     bWAK_RXD0_LO    // wake-up by RXD0 low level
@@ -180,24 +247,52 @@ inline void BOOT_now(void) {
 #define WAKE_RST      bWAK_RST_HI     // wake-up by pin RST high level
 #define WAKE_INT      bWAK_P3_2E_3L   // wake-up by pin P3.2 (INT0) edge or pin P3.3 (INT1) low level
 
-#define WAKE_enable(source)     WAKE_CTRL |=  source
-#define WAKE_disable(source)    WAKE_CTRL &= ~source
-#define WAKE_all_disable()      WAKE_CTRL  =  0
-
-#define WAKE_USB_enable()       WAKE_CTRL |=  bWAK_BY_USB
-#define WAKE_RXD0_enable()      WAKE_CTRL |=  bWAK_RXD0_LO
-#define WAKE_RXD1_enable()      WAKE_CTRL |=  bWAK_RXD1_LO
-#define WAKE_P13_enable()       WAKE_CTRL |=  bWAK_P1_3_LO
-#define WAKE_P14_enable()       WAKE_CTRL |=  bWAK_P1_4_LO
-#define WAKE_P15_enable()       WAKE_CTRL |=  bWAK_P1_5_LO
-#define WAKE_RST_enable()       WAKE_CTRL |=  bWAK_RST_HI
-#define WAKE_INT_enable()       WAKE_CTRL |=  bWAK_P3_2E_3L
-
-#define WAKE_USB_disable()      WAKE_CTRL &= ~bWAK_BY_USB
-#define WAKE_RXD0_disable()     WAKE_CTRL &= ~bWAK_RXD0_LO
-#define WAKE_RXD1_disable()     WAKE_CTRL &= ~bWAK_RXD1_LO
-#define WAKE_P13_disable()      WAKE_CTRL &= ~bWAK_P1_3_LO
-#define WAKE_P14_disable()      WAKE_CTRL &= ~bWAK_P1_4_LO
-#define WAKE_P15_disable()      WAKE_CTRL &= ~bWAK_P1_5_LO
-#define WAKE_RST_disable()      WAKE_CTRL &= ~bWAK_RST_HI
-#define WAKE_INT_disable()      WAKE_CTRL &= ~bWAK_P3_2E_3L
+// WAKE_CTRL can only be written in safe mode, interrupts are held off so that
+// nothing runs between the two unlock writes
+inline void WAKE_enable(uint8_t source) {
+  __bit ea    = EA;
+  EA          = 0;
+  SAFE_MOD    = 0x55;
+  SAFE_MOD    = 0xAA;
+  WAKE_CTRL  |= source;
+  SAFE_MOD    = 0x00;
+  EA          = ea;
+}
+
+inline void WAKE_disable(uint8_t source) {
+  __bit ea    = EA;
+  EA          = 0;
+  SAFE_MOD    = 0x55;
+  SAFE_MOD    = 0xAA;
+  WAKE_CTRL  &= ~source;
+  SAFE_MOD    = 0x00;
+  EA          = ea;
+}
+
+inline void WAKE_all_disable(void) {
+  __bit ea    = EA;
+  EA          = 0;
+  SAFE_MOD    = 0x55;
+  SAFE_MOD    = 0xAA;
+  WAKE_CTRL   = 0;
+  SAFE_MOD    = 0x00;
+  EA          = ea;
+}
+
+#define WAKE_USB_enable()       WAKE_enable(bWAK_BY_USB)
+#define WAKE_RXD0_enable()      WAKE_enable(bWAK_RXD0_LO)
+#define WAKE_RXD1_enable()      WAKE_enable(bWAK_RXD1_LO)
+#define WAKE_P13_enable()       WAKE_enable(bWAK_P1_3_LO)
+#define WAKE_P14_enable()       WAKE_enable(bWAK_P1_4_LO)
+#define WAKE_P15_enable()       WAKE_enable(bWAK_P1_5_LO)
+#define WAKE_RST_enable()       WAKE_enable(bWAK_RST_HI)
+#define WAKE_INT_enable()       WAKE_enable(bWAK_P3_2E_3L)
+
+#define WAKE_USB_disable()      WAKE_disable(bWAK_BY_USB)
+#define WAKE_RXD0_disable()     WAKE_disable(bWAK_RXD0_LO)
+#define WAKE_RXD1_disable()     WAKE_disable(bWAK_RXD1_LO)
+#define WAKE_P13_disable()      WAKE_disable(bWAK_P1_3_LO)
+#define WAKE_P14_disable()      WAKE_disable(bWAK_P1_4_LO)
+#define WAKE_P15_disable()      WAKE_disable(bWAK_P1_5_LO)
+#define WAKE_RST_disable()      WAKE_disable(bWAK_RST_HI)
+#define WAKE_INT_disable()      WAKE_disable(bWAK_P3_2E_3L)
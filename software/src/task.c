@@ -0,0 +1,48 @@
+// ===================================================================================
+// Cooperative Task Scheduler for CH551, CH552 and CH554
+// ===================================================================================
+
+#include "task.h"
+#include "tick.h"
+
+__xdata TASK_func TASK_funcs[TASK_COUNT];   // task functions (0 = inactive)
+__xdata uint16_t  TASK_due[TASK_COUNT];     // deadlines in ms
+__xdata uint16_t  TASK_period[TASK_COUNT];  // periods in ms (0 = one-shot)
+
+// ===================================================================================
+// Schedule Tasks
+// ===================================================================================
+void TASK_every(uint8_t id, TASK_func func, uint16_t period) {
+  TASK_due[id]    = TICK_millis() + period;
+  TASK_period[id] = period;
+  TASK_funcs[id]  = func;
+}
+
+void TASK_after(uint8_t id, TASK_func func, uint16_t delay) {
+  TASK_due[id]    = TICK_millis() + delay;
+  TASK_period[id] = 0;
+  TASK_funcs[id]  = func;
+}
+
+// ===================================================================================
+// Run all Due Tasks
+// ===================================================================================
+void TASK_run(void) {
+  uint8_t   id;
+  uint16_t  now;
+  TASK_func func;
+
+  for(id=0; id<TASK_COUNT; id++) {
+    func = TASK_funcs[id];
+    if(!func) continue;                               // task not active
+    now = TICK_millis();
+    if(TICK_before(now, TASK_due[id])) continue;      // task not due yet
+    if(TASK_period[id]) {                             // periodic task?
+      TASK_due[id] += TASK_period[id];                // next deadline, keep phase
+      if(!TICK_before(now, TASK_due[id]))             // fallen behind?
+        TASK_due[id] = now + TASK_period[id];         // skip missed runs
+    }
+    else TASK_funcs[id] = 0;                          // one-shot: remove task
+    func();                                           // run task
+  }
+}
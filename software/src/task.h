@@ -0,0 +1,36 @@
+// ===================================================================================
+// Cooperative Task Scheduler for CH551, CH552 and CH554
+// ===================================================================================
+//
+// Small cooperative scheduler on top of the 1ms timebase (tick.h). Each task has a
+// deadline in ms and is either periodic or one-shot. TASK_run() is called once per
+// tick and only calls the tasks which are due. Tasks must not block for long, as 
+// all other tasks wait for them. Periodic tasks keep their phase; if they fall 
+// behind by more than one period, missed runs are skipped instead of being caught
+// up in a burst.
+//
+// The following must be defined in config.h:
+// TASK_COUNT - number of task slots (task IDs are 0..TASK_COUNT-1)
+//
+// Functions available:
+// --------------------
+// TASK_every(id, func, period)   run func every period ms (first run after period)
+// TASK_after(id, func, delay)    run func once after delay ms (restarts if pending)
+// TASK_stop(id)                  stop task
+// TASK_active(id)                check if task is scheduled
+// TASK_run()                     run all due tasks, call once per tick
+
+#pragma once
+#include <stdint.h>
+#include "config.h"
+
+typedef void (*TASK_func)(void);
+
+extern __xdata TASK_func TASK_funcs[TASK_COUNT];
+
+#define TASK_stop(id)     TASK_funcs[id] = 0
+#define TASK_active(id)   (TASK_funcs[id] != 0)
+
+void TASK_every(uint8_t id, TASK_func func, uint16_t period);
+void TASK_after(uint8_t id, TASK_func func, uint16_t delay);
+void TASK_run(void);
@@ -0,0 +1,40 @@
+// ===================================================================================
+// USB Transport Health Telemetry for CH551, CH552 and CH554
+// ===================================================================================
+
+#include "tele.h"
+#include "ch554.h"
+#include "system.h"
+#include "usb_descr.h"
+
+#if EP_BUF_END > TELE_ADDR
+#error "USB endpoint buffers overlap the telemetry block"
+#endif
+
+// ===================================================================================
+// Check Telemetry Block and Count Reset Cause (call once at start)
+// ===================================================================================
+void TELE_init(void) {
+  __xdata uint8_t *ptr;
+  uint8_t i;
+
+  // Clear block after power-on or if it was never written
+  if(RST_wasPWR() || (RST_getKeep() != TELE_KEEP) || (TELE_data.magic != TELE_MAGIC)) {
+    ptr = (__xdata uint8_t *)&TELE_data;
+    for(i=0; i<sizeof(TELE_data); i++) *ptr++ = 0;
+    TELE_data.magic = TELE_MAGIC;
+    RST_keep(TELE_KEEP);
+  }
+
+  // Count cause of this reset
+  if(RST_wasWDT()) {
+    TELE_data.cause = TELE_RST_WDT;
+    TELE_count(wdtResets);
+  }
+  else if(RST_wasSOFT() || RST_wasPIN()) {
+    TELE_data.cause = RST_wasPIN() ? TELE_RST_PIN : TELE_RST_SOFT;
+    TELE_count(softResets);
+  }
+  else TELE_data.cause = TELE_RST_POWER;
+  TELE_count(boots);
+}
@@ -0,0 +1,72 @@
+// ===================================================================================
+// USB Transport Health Telemetry for CH551, CH552 and CH554
+// ===================================================================================
+//
+// Counts events of the USB transport (bus resets, suspends, stalled SETUP requests,
+// EP1 busy-wait spins, dropped and coalesced reports) and the causes of the device resets. The
+// counters are kept in a block at a fixed xdata address below XRAM_LOC, which is
+// not cleared by the startup code, so they survive watchdog, software and RST pin
+// resets. Only a power-on reset clears them. The host reads the block as feature
+// report (see diag.h).
+//
+// The block is valid if RESET_KEEP (cleared by power-on reset only) and the magic
+// number of the block match, otherwise it is cleared at startup.
+//
+// Functions available:
+// --------------------
+// TELE_init()              check block, count reset cause, must be called at start
+// TELE_count(counter)      increment 16-bit counter (saturating)
+//
+// Counters (TELE_data.xxx):
+// -------------------------
+// boots                    starts since power-on (including the first one)
+// wdtResets                resets by the watchdog timer
+// softResets               resets by software or the RST pin
+// busResets                USB bus resets
+// suspends                 USB bus suspends
+// stalls                   SETUP requests answered with STALL
+// dropped                  reports dropped while the host was sleeping or the queue full
+// spins                    HID_sendReport waits for room in the report queue (32-bit)
+// coalesced                mouse or gamepad updates held back while EP1 was busy, they
+//                          are merged into the next report
+//
+// Notes:
+// ------
+// - The endpoint buffers must end below TELE_ADDR (checked in tele.c).
+
+#pragma once
+#include <stdint.h>
+
+#define TELE_ADDR       0x00E0              // fixed block address (below XRAM_LOC)
+#define TELE_MAGIC      0x54C4              // block is valid (changes with the layout)
+#define TELE_KEEP       0xA5                // RESET_KEEP value after first start
+
+// Cause of the last reset
+#define TELE_RST_POWER  0                   // power-on
+#define TELE_RST_SOFT   1                   // software
+#define TELE_RST_WDT    2                   // watchdog timer
+#define TELE_RST_PIN    3                   // RST pin
+
+// Telemetry block (little-endian, sent as is to the host)
+typedef struct {
+  uint8_t  id;                              // report ID
+  uint8_t  cause;                           // cause of the last reset (TELE_RST_xxx)
+  uint16_t boots;                           // starts since power-on
+  uint16_t wdtResets;                       // watchdog resets
+  uint16_t softResets;                      // software and RST pin resets
+  uint16_t busResets;                       // USB bus resets
+  uint16_t suspends;                        // USB bus suspends
+  uint16_t stalls;                          // stalled SETUP requests
+  uint16_t dropped;                         // reports dropped (host sleeps, queue full)
+  uint32_t spins;                           // waits for room in the report queue
+  uint16_t coalesced;                       // updates merged into a later report
+  uint16_t magic;                           // TELE_MAGIC if valid (not sent)
+} TELE_DATA;
+
+#define TELE_REPORT_LEN (sizeof(TELE_DATA) - sizeof(uint16_t))
+
+__xdata __at(TELE_ADDR) TELE_DATA TELE_data;
+
+#define TELE_count(counter) if(TELE_data.counter != 0xFFFF) TELE_data.counter++
+
+void TELE_init(void);                       // check block, count reset cause
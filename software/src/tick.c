@@ -0,0 +1,89 @@
+// ===================================================================================
+// System Tick Functions for CH551, CH552 and CH554
+// ===================================================================================
+
+#include "tick.h"
+#include "system.h"
+#include "cal.h"
+#include "prof.h"
+
+volatile __bit TICK_flag = 0;               // set on every tick
+volatile uint16_t TICK_ms = 0;              // milliseconds since start
+
+// ===================================================================================
+// Timer0 Reload Values
+// ===================================================================================
+// Timer0 runs at Fsys/12. The reload values depend on the current system clock, 
+// so the timebase stays correct when the clock is changed with CLK_set().
+// After an SOF, the timer is loaded with 1.125ms, so that it does not race the
+// next SOF, but catches it if it is missing.
+#define TICK_CNT(f)       (uint16_t)(65536UL - (f) / 12000UL)
+
+__code uint16_t TICK_period[] = {           // 1ms, index: CLK_get()
+  TICK_CNT(187500UL),   TICK_CNT(750000UL),   TICK_CNT(3000000UL),  TICK_CNT(6000000UL),
+  TICK_CNT(12000000UL), TICK_CNT(16000000UL), TICK_CNT(24000000UL), TICK_CNT(32000000UL)
+};
+
+__code uint16_t TICK_timeout[] = {          // 1.125ms, index: CLK_get()
+  TICK_CNT(210937UL),   TICK_CNT(843750UL),   TICK_CNT(3375000UL),  TICK_CNT(6750000UL),
+  TICK_CNT(13500000UL), TICK_CNT(18000000UL), TICK_CNT(27000000UL), TICK_CNT(36000000UL)
+};
+
+// ===================================================================================
+// Setup Timer0 and Start Timebase
+// ===================================================================================
+void TICK_init(void) {
+  TMOD = (TMOD & ~MASK_T0_MOD) | bT0_M0;    // timer0 mode 1: 16-bit timer, Fsys/12
+  TL0  = (uint8_t)TICK_period[CLK_get()];   // load timer for 1ms
+  TH0  = TICK_period[CLK_get()] >> 8;
+  ET0  = 1;                                 // enable timer0 interrupt
+  TR0  = 1;                                 // start timer0
+}
+
+// ===================================================================================
+// Wait for Next Tick
+// ===================================================================================
+void TICK_wait(void) {
+  while(!TICK_flag) WAIT_hook();            // wait for tick
+  TICK_flag = 0;                            // clear flag
+}
+
+// ===================================================================================
+// Get Milliseconds since Start
+// ===================================================================================
+// The 16-bit counter is incremented by interrupts, so it must be read atomically.
+// The interrupt state is restored, so it can also be called with interrupts off.
+uint16_t TICK_millis(void) {
+  uint16_t ms;
+  __bit ea = EA;
+  EA = 0;
+  ms = TICK_ms;
+  EA = ea;
+  return ms;
+}
+
+// ===================================================================================
+// SOF Handler (called by USB interrupt)
+// ===================================================================================
+void TICK_SOF(void) {
+  PROF_start(PROF_SOF);
+  CAL_SOF();                                // timestamp for oscillator calibration
+  TR0 = 0;                                  // stop timer0
+  TL0 = (uint8_t)TICK_timeout[CLK_get()];   // restart with timeout
+  TH0 = TICK_timeout[CLK_get()] >> 8;
+  TF0 = 0;                                  // clear pending overflow
+  TR0 = 1;                                  // start timer0
+  TICK_ms++;                                // count milliseconds
+  TICK_flag = 1;                            // new tick
+  PROF_stop(PROF_SOF);
+}
+
+// ===================================================================================
+// Timer0 Interrupt Handler (no SOF received within timeout)
+// ===================================================================================
+void TICK_interrupt(void) {
+  TL0 = (uint8_t)TICK_period[CLK_get()];    // reload timer for 1ms
+  TH0 = TICK_period[CLK_get()] >> 8;
+  TICK_ms++;                                // count milliseconds
+  TICK_flag = 1;                            // new tick
+}
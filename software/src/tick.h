@@ -0,0 +1,40 @@
+// ===================================================================================
+// System Tick Functions for CH551, CH552 and CH554
+// ===================================================================================
+//
+// 1 kHz system timebase. While the USB bus is active, every Start-of-Frame packet
+// (SOF) of the host generates a tick, so all work done after TICK_wait() runs in
+// phase with the USB frames and is finished before the host polls the endpoints.
+// If there are no SOFs (bus suspended, not connected), timer0 takes over and 
+// generates the ticks. Timer0 is restarted with every SOF and only overflows if 
+// an SOF is missing.
+//
+// Functions available:
+// --------------------
+// TICK_init()              setup timer0 and start timebase
+// TICK_wait()              wait for next tick
+// TICK_millis()            get milliseconds since start (16-bit, wraps every 65.5s)
+// TICK_before(a, b)        check if time a is before time b (wrap-safe)
+// TICK_SOF()               SOF handler, must be called by USB interrupt
+// TICK_interrupt()         timer0 handler, must be called by timer0 interrupt
+//
+// The CH55x has no CPU idle mode (only power-down, which stops the timers), so 
+// TICK_wait() polls the tick flag. Run it at a reduced clock (CLK_set) to save 
+// power between ticks.
+//
+// Timer0 is used by this library.
+
+#pragma once
+#include <stdint.h>
+
+extern volatile __bit TICK_flag;            // set on every tick
+extern volatile uint16_t TICK_ms;           // milliseconds since start
+
+// Time comparison, works across the 16-bit wrap-around for up to 32.7s apart
+#define TICK_before(a, b) ((int16_t)((uint16_t)(a) - (uint16_t)(b)) < 0)
+
+void TICK_init(void);                       // setup timer0 and start timebase
+void TICK_wait(void);                       // wait for next tick
+uint16_t TICK_millis(void);                 // get milliseconds since start
+void TICK_SOF(void);                        // SOF handler (USB interrupt)
+void TICK_interrupt(void);                  // timer0 interrupt handler
@@ -0,0 +1,84 @@
+// ===================================================================================
+// Input Event Trace for CH551, CH552 and CH554
+// ===================================================================================
+
+#include "trace.h"
+
+#ifdef TRACE_ENABLE
+
+#include "tick.h"
+
+__xdata TRACE_ENTRY TRACE_ring[TRACE_SIZE]; // ring buffer
+uint8_t TRACE_head  = 0;                    // next entry to write
+uint8_t TRACE_chunk = 0;                    // next chunk to read by host
+uint8_t TRACE_raw   = 0;                    // raw inputs of the previous scan
+__bit TRACE_frozen  = 0;                    // recording stopped by host
+__bit TRACE_wrapped = 0;                    // ring was filled at least once
+
+// ===================================================================================
+// Add Entry (main loop only)
+// ===================================================================================
+void TRACE_add(uint8_t type, uint8_t data) {
+  __xdata TRACE_ENTRY *e;
+  if(TRACE_frozen) return;                  // host is reading the ring
+  e = &TRACE_ring[TRACE_head];
+  e->ms   = TICK_millis();
+  e->type = type;
+  e->data = data;
+  if(++TRACE_head >= TRACE_SIZE) {
+    TRACE_head    = 0;
+    TRACE_wrapped = 1;
+  }
+}
+
+// Raw pin transitions and debounce decisions of one scan. A raw transition which
+// does not result in an accepted edge was rejected (input locked or bounced back).
+void TRACE_scan(uint8_t in, uint8_t changed) {
+  uint8_t edges = in ^ TRACE_raw;
+  if(edges) {
+    TRACE_raw = in;
+    TRACE_add(TRACE_PIN, in);
+    if(edges & ~changed) TRACE_add(TRACE_REJECT, edges & ~changed);
+  }
+  if(changed) TRACE_add(TRACE_ACCEPT, changed);
+}
+
+// Sent HID report: report ID and first key code (keyboard) or first data byte
+void TRACE_report(__xdata uint8_t *buf, uint8_t len) {
+  TRACE_add(TRACE_REPORT | buf[0], (buf[0] == 1) && (len > 3) ? buf[3] : buf[1]);
+}
+
+// ===================================================================================
+// Host Interface (called by USB interrupt)
+// ===================================================================================
+void TRACE_command(uint8_t cmd) {
+  uint8_t i;
+  if(cmd == TRACE_CMD_FREEZE) {
+    TRACE_frozen = 1;
+    TRACE_chunk  = 0;
+  }
+  else if(cmd == TRACE_CMD_RUN) {
+    for(i=0; i<TRACE_SIZE; i++) TRACE_ring[i].type = TRACE_EMPTY;
+    TRACE_head    = 0;
+    TRACE_chunk   = 0;
+    TRACE_wrapped = 0;
+    TRACE_frozen  = 0;
+  }
+}
+
+// Fill feature report with the next chunk of the ring (physical order), the
+// header tells the host where the oldest entry is. Returns the report length.
+uint8_t TRACE_getChunk(__xdata uint8_t *buf) {
+  uint8_t i;
+  __xdata uint8_t *src = (__xdata uint8_t *)&TRACE_ring[TRACE_chunk * TRACE_CHUNK];
+  buf[1] = (uint8_t)TRACE_frozen | ((uint8_t)TRACE_wrapped << 1);
+  buf[2] = TRACE_SIZE;
+  buf[3] = TRACE_head;
+  buf[4] = TRACE_chunk;
+  buf   += TRACE_HEADER;
+  for(i=0; i<TRACE_CHUNK * sizeof(TRACE_ENTRY); i++) *buf++ = *src++;
+  if(++TRACE_chunk >= TRACE_SIZE / TRACE_CHUNK) TRACE_chunk = 0;
+  return TRACE_HEADER + TRACE_CHUNK * sizeof(TRACE_ENTRY);
+}
+
+#endif
@@ -0,0 +1,87 @@
+// ===================================================================================
+// Input Event Trace for CH551, CH552 and CH554
+// ===================================================================================
+//
+// Records raw pin transitions, debounce decisions, encoder steps and sent HID
+// reports with a millisecond timestamp in a ring buffer in xdata. When the ring is
+// full, the oldest entries are overwritten. The host freezes the ring and reads it
+// in chunks of 64 bytes as feature report (see diag.h), tools/trace.py turns it
+// into a timeline.
+//
+// The trace is only compiled in if TRACE_ENABLE is defined in config.h, otherwise
+// the macros are empty and cost nothing.
+//
+// Macros available:
+// -----------------
+// TRACE_add(type, data)    add entry (TRACE_xxx), ignored while frozen
+// TRACE_scan(in, changed)  add entries for a debounce step: raw inputs in, accepted
+//                          edges changed
+// TRACE_report(buf, len)   add entry for a sent HID report
+//
+// Functions available:
+// --------------------
+// TRACE_command(cmd)       host command (TRACE_CMD_xxx)
+// TRACE_getChunk(buf)      fill feature report with next chunk, return length
+//
+// Entries (4 bytes, little-endian):
+// ---------------------------------
+// uint16  timestamp in ms (TICK_millis)
+// uint8   type:  TRACE_PIN     raw inputs changed,     data: raw inputs (IN_xxx)
+//                TRACE_ACCEPT  debounce accepted edge, data: inputs with edge
+//                TRACE_REJECT  debounce rejected edge, data: inputs with edge
+//                TRACE_ENC     encoder step,           data: TRACE_CW or TRACE_CCW
+//                TRACE_REPORT  | report ID (bit 7 set), data: first key code of a
+//                              keyboard report (ID 1), first data byte otherwise
+// uint8   data
+//
+// Notes:
+// ------
+// - Entries are only added from the main loop, the USB interrupt only reads the
+//   ring while it is frozen.
+// - TRACE_SIZE in config.h must be a multiple of TRACE_CHUNK.
+
+#pragma once
+#include <stdint.h>
+#include "config.h"
+
+// Entry types
+#define TRACE_EMPTY         0x00            // unused entry
+#define TRACE_PIN           0x01            // raw pin transition
+#define TRACE_ACCEPT        0x02            // edge accepted by debounce
+#define TRACE_REJECT        0x03            // edge rejected by debounce (bouncing)
+#define TRACE_ENC           0x04            // rotary encoder step
+#define TRACE_REPORT        0x80            // HID report sent (| report ID)
+
+// Data of TRACE_ENC
+#define TRACE_CW            0x01            // clockwise
+#define TRACE_CCW           0x02            // counter-clockwise
+
+// Host commands (first data byte of the feature report)
+#define TRACE_CMD_RUN       0x00            // clear ring and resume recording
+#define TRACE_CMD_FREEZE    0x01            // stop recording, rewind to first chunk
+
+#define TRACE_CHUNK         16              // entries per chunk (64 bytes)
+#define TRACE_HEADER        5               // report ID + header bytes of a chunk
+
+#ifdef TRACE_ENABLE
+
+// Ring buffer entry
+typedef struct {
+  uint16_t ms;                              // timestamp in ms
+  uint8_t  type;                            // TRACE_xxx
+  uint8_t  data;                            // depends on type
+} TRACE_ENTRY;
+
+void TRACE_add(uint8_t type, uint8_t data);
+void TRACE_scan(uint8_t in, uint8_t changed);
+void TRACE_report(__xdata uint8_t *buf, uint8_t len);
+void TRACE_command(uint8_t cmd);
+uint8_t TRACE_getChunk(__xdata uint8_t *buf);
+
+#else
+
+#define TRACE_add(type, data)
+#define TRACE_scan(in, changed)
+#define TRACE_report(buf, len)
+
+#endif
@@ -115,6 +115,8 @@
 #define USB_DESCR_TYP_SPEED     0x07
 #define USB_DESCR_TYP_OTG       0x09
 #define USB_DESCR_TYP_IAD       0x0B
+#define USB_DESCR_TYP_BOS       0x0F
+#define USB_DESCR_TYP_DEV_CAP   0x10
 #define USB_DESCR_TYP_HID       0x21
 #define USB_DESCR_TYP_REPORT    0x22
 #define USB_DESCR_TYP_PHYSIC    0x23
@@ -294,6 +296,70 @@ typedef struct _USB_HID_DESCR {
 } USB_HID_DESCR, *PUSB_HID_DESCR;
 typedef USB_HID_DESCR __xdata *PXUSB_HID_DESCR;
 
+// Audio class (USB MIDI 1.0) descriptors
+#define USB_AUDIO_SUBCL_CONTROL   0x01      // audio control interface
+#define USB_AUDIO_SUBCL_MIDI      0x03      // MIDI streaming interface
+#define USB_MIDI_JACK_EMBEDDED    0x01
+#define USB_MIDI_JACK_EXTERNAL    0x02
+
+typedef struct _USB_AUDIO_ENDP_DESCR {      // standard endpoint descriptor (audio)
+    uint8_t  bLength;
+    uint8_t  bDescriptorType;
+    uint8_t  bEndpointAddress;
+    uint8_t  bmAttributes;
+    uint16_t wMaxPacketSize;
+    uint8_t  bInterval;
+    uint8_t  bRefresh;
+    uint8_t  bSynchAddress;
+} USB_AUDIO_ENDP_DESCR, *PUSB_AUDIO_ENDP_DESCR;
+
+typedef struct _USB_AC_HEADER_DESCR {       // audio control interface header
+    uint8_t  bLength;
+    uint8_t  bDescriptorType;
+    uint8_t  bDescriptorSubtype;
+    uint16_t bcdADC;
+    uint16_t wTotalLength;
+    uint8_t  bInCollection;
+    uint8_t  baInterfaceNr;                 // one streaming interface
+} USB_AC_HEADER_DESCR, *PUSB_AC_HEADER_DESCR;
+
+typedef struct _USB_MS_HEADER_DESCR {       // MIDI streaming interface header
+    uint8_t  bLength;
+    uint8_t  bDescriptorType;
+    uint8_t  bDescriptorSubtype;
+    uint16_t bcdMSC;
+    uint16_t wTotalLength;
+} USB_MS_HEADER_DESCR, *PUSB_MS_HEADER_DESCR;
+
+typedef struct _USB_MIDI_IN_JACK_DESCR {
+    uint8_t  bLength;
+    uint8_t  bDescriptorType;
+    uint8_t  bDescriptorSubtype;
+    uint8_t  bJackType;
+    uint8_t  bJackID;
+    uint8_t  iJack;
+} USB_MIDI_IN_JACK_DESCR, *PUSB_MIDI_IN_JACK_DESCR;
+
+typedef struct _USB_MIDI_OUT_JACK_DESCR {   // one input pin
+    uint8_t  bLength;
+    uint8_t  bDescriptorType;
+    uint8_t  bDescriptorSubtype;
+    uint8_t  bJackType;
+    uint8_t  bJackID;
+    uint8_t  bNrInputPins;
+    uint8_t  baSourceID;
+    uint8_t  baSourcePin;
+    uint8_t  iJack;
+} USB_MIDI_OUT_JACK_DESCR, *PUSB_MIDI_OUT_JACK_DESCR;
+
+typedef struct _USB_MS_ENDP_DESCR {         // MIDI streaming endpoint, one jack
+    uint8_t  bLength;
+    uint8_t  bDescriptorType;
+    uint8_t  bDescriptorSubtype;
+    uint8_t  bNumEmbMIDIJack;
+    uint8_t  baAssocJackID;
+} USB_MS_ENDP_DESCR, *PUSB_MS_ENDP_DESCR;
+
 typedef struct _UDISK_BOC_CBW {             // command of BulkOnly USB-FlashDisk
     uint8_t mCBW_Sig0;
     uint8_t mCBW_Sig1;
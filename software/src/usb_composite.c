@@ -5,19 +5,34 @@
 #include "usb_composite.h"
 #include "usb_hid.h"
 #include "usb_handler.h"
+#include "diag.h"
+#include "tele.h"
 
 #define KBD_sendReport()    HID_sendReport(KBD_report, sizeof(KBD_report))
 #define CON_sendReport()    HID_sendReport(CON_report, sizeof(CON_report))
 #define JOY_sendReport()    HID_sendReport(JOY_report, sizeof(JOY_report))
 #define MOUSE_sendReport()  HID_sendReport(MOUSE_report, sizeof(MOUSE_report))
+#define SYS_sendReport()    HID_sendReport(SYS_report, sizeof(SYS_report))
+#define DIAL_sendReport()   HID_sendReport(DIAL_report, sizeof(DIAL_report))
 
 // ===================================================================================
 // HID reports
 // ===================================================================================
 __xdata uint8_t KBD_report[]   = {1,0,0,0,0,0,0,0};
-__xdata uint8_t CON_report[]   = {2,0,0};
-__xdata uint8_t MOUSE_report[] = {3,0,0,0,0};
-__xdata uint8_t JOY_report[]   = {4,0,0,0};
+__xdata uint8_t CON_report[1 + 2 * CON_SLOTS] = {2};
+__xdata uint8_t MOUSE_report[] = {3,0,0,0,0,0};
+__xdata uint8_t JOY_report[]   = {4,0,0,8,0,0};
+__xdata uint8_t SYS_report[]   = {5,0};
+__xdata uint8_t DIAL_report[]  = {6,0,0};
+
+volatile uint8_t MOUSE_resMult = 0;             // resolution multipliers (host)
+int16_t MOUSE_xSteps     = 0;                   // pointer movement not sent yet
+int16_t MOUSE_ySteps     = 0;
+int16_t MOUSE_wheelSteps = 0;                   // wheel steps not sent yet
+int16_t MOUSE_panSteps   = 0;                   // pan steps not sent yet
+
+uint8_t JOY_dirs = 0;                           // pressed hat directions (JOY_HAT_xxx)
+__bit   JOY_changed = 0;                        // report changed since last sent
 
 // ===================================================================================
 // ASCII to keycode mapping table
@@ -121,22 +136,79 @@ void KBD_print(char* str) {
 // Consumer Multimedia Keyboard Functions
 // ===================================================================================
 
+// Each slot holds a 16-bit usage (little-endian), 0 = empty slot
+
 // Press a consumer key on keyboard
-void CON_press(uint8_t key) {
-  CON_report[1] = key;
-  CON_sendReport();                             // send report
+void CON_press(uint16_t key) {
+  uint8_t i;
+
+  // Check if key is already present in report
+  for(i=1; i<sizeof(CON_report); i+=2) {
+    if( (CON_report[i] == (uint8_t)key) && (CON_report[i+1] == (uint8_t)(key >> 8)) )
+      return;                                   // return if already in report
+  }
+
+  // Find an empty slot, insert key and transmit report
+  for(i=1; i<sizeof(CON_report); i+=2) {
+    if(!CON_report[i] && !CON_report[i+1]) {    // empty slot?
+      CON_report[i]   = (uint8_t)key;           // insert key
+      CON_report[i+1] = (uint8_t)(key >> 8);
+      CON_sendReport();                         // send report
+      return;                                   // and return
+    }
+  }
 }
 
 // Release a consumer key on keyboard
-void CON_release(void) {
-  CON_report[1] = 0;
-  CON_sendReport();
+void CON_release(uint16_t key) {
+  uint8_t i;
+  for(i=1; i<sizeof(CON_report); i+=2) {
+    if( (CON_report[i] == (uint8_t)key) && (CON_report[i+1] == (uint8_t)(key >> 8)) ) {
+      CON_report[i]   = 0;                      // delete key in report
+      CON_report[i+1] = 0;
+    }
+  }
+  CON_sendReport();                             // send report
 }
 
 // Press and release a consumer key on keyboard
-void CON_type(uint8_t key) {
+void CON_type(uint16_t key) {
   CON_press(key);
-  CON_release();
+  CON_release(key);
+}
+
+// Release all consumer keys on keyboard
+void CON_releaseAll(void) {
+  uint8_t i;
+  for(i=sizeof(CON_report)-1; i; i--) CON_report[i] = 0;  // delete all keys in report
+  CON_sendReport();                             // send report
+}
+
+// ===================================================================================
+// System Control Functions
+// ===================================================================================
+
+// Press a system control key (wakes up the host instead if it is sleeping)
+void SYS_press(uint8_t key) {
+  if(USB_suspendFlag) {                         // host is sleeping?
+    if(USB_remoteWakeFlag) USB_wakeHost();      // wake it up if allowed
+    return;                                     // but don't send the key
+  }
+  SYS_report[1] = key;
+  SYS_sendReport();                             // send report
+}
+
+// Release system control key
+void SYS_release(void) {
+  if(!SYS_report[1]) return;                    // no key pressed (or wake-up only)
+  SYS_report[1] = 0;
+  if(!USB_suspendFlag) SYS_sendReport();        // don't wake up host just to release
+}
+
+// Press and release a system control key
+void SYS_type(uint8_t key) {
+  SYS_press(key);
+  SYS_release();
 }
 
 // ===================================================================================
@@ -164,32 +236,176 @@ void MOUSE_move(int8_t xrel, int8_t yrel) {
   MOUSE_report[3] = 0;
 }
 
+// Convert detents into wheel units of the current host resolution
+int8_t MOUSE_scale(int8_t rel, uint8_t hires) {
+  int16_t units = rel;
+  if(hires) units *= MOUSE_WHEEL_RES;           // host expects hi-res steps
+  if(units >  127) units =  127;
+  if(units < -127) units = -127;
+  return (int8_t)units;
+}
+
 // Move mouse wheel
 void MOUSE_wheel(int8_t rel) {
-  MOUSE_report[4] = (uint8_t)rel;               // set relative wheel movement
+  MOUSE_report[4] = (uint8_t)MOUSE_scale(rel, MOUSE_resMult & MOUSE_RES_WHEEL);
   MOUSE_sendReport();                           // send HID report
   MOUSE_report[4] = 0;                          // reset movements
 }
 
+// Move horizontal mouse wheel (AC Pan)
+void MOUSE_pan(int8_t rel) {
+  MOUSE_report[5] = (uint8_t)MOUSE_scale(rel, MOUSE_resMult & MOUSE_RES_PAN);
+  MOUSE_sendReport();                           // send HID report
+  MOUSE_report[5] = 0;                          // reset movements
+}
+
+// Add pointer movement (sent by MOUSE_flush)
+void MOUSE_addMove(int8_t xrel, int8_t yrel) {
+  MOUSE_xSteps += xrel;
+  MOUSE_ySteps += yrel;
+}
+
+// Add high-resolution wheel steps (sent by MOUSE_flush)
+void MOUSE_wheelHiRes(int8_t steps) {
+  MOUSE_wheelSteps += steps;
+}
+
+// Add high-resolution pan steps (sent by MOUSE_flush)
+void MOUSE_panHiRes(int8_t steps) {
+  MOUSE_panSteps += steps;
+}
+
+// Take as many of the added steps as the host resolution and the report allow
+int8_t MOUSE_take(int16_t *steps, uint8_t hires) {
+  int16_t units = *steps;
+  if(!hires) units /= MOUSE_WHEEL_RES;          // whole detents only
+  if(units >  127) units =  127;
+  if(units < -127) units = -127;
+  *steps -= hires ? units : units * MOUSE_WHEEL_RES;  // keep the remainder
+  return (int8_t)units;
+}
+
+// Send added movements in one report (call once per frame)
+void MOUSE_flush(void) {
+  if(HID_busy()) {                              // last report not fetched: keep adding
+    if(MOUSE_xSteps || MOUSE_ySteps || MOUSE_wheelSteps || MOUSE_panSteps)
+      TELE_count(coalesced);                    // steps go out with later ones
+    return;
+  }
+  MOUSE_report[2] = MOUSE_take(&MOUSE_xSteps, 1);
+  MOUSE_report[3] = MOUSE_take(&MOUSE_ySteps, 1);
+  MOUSE_report[4] = MOUSE_take(&MOUSE_wheelSteps, MOUSE_resMult & MOUSE_RES_WHEEL);
+  MOUSE_report[5] = MOUSE_take(&MOUSE_panSteps,   MOUSE_resMult & MOUSE_RES_PAN);
+  if(!MOUSE_report[2] && !MOUSE_report[3] && !MOUSE_report[4] && !MOUSE_report[5])
+    return;                                     // less than one unit
+  MOUSE_sendReport();                           // send HID report
+  MOUSE_report[2] = 0;                          // reset movements
+  MOUSE_report[3] = 0;
+  MOUSE_report[4] = 0;
+  MOUSE_report[5] = 0;
+}
+
 // ===================================================================================
-// Joystick Functions
+// Radial Controller Functions
 // ===================================================================================
 
-// Press joystick button(s)
-void JOY_press(uint8_t buttons) {
-  JOY_report[1] |= buttons;                     // press button(s)
-  JOY_sendReport();                             // send HID report
+// Report: bit 0 button, bits 1-15 relative rotation in 1/10 degrees
+
+// Press dial button
+void DIAL_press(void) {
+  DIAL_report[1] |= 0x01;                       // press button
+  DIAL_sendReport();                            // send HID report
 }
 
-// Release joystick button(s)
-void JOY_release(uint8_t buttons) {
-  JOY_report[1] &= ~buttons;                    // release button(s)
-  JOY_sendReport();                             // send HID report
+// Release dial button
+void DIAL_release(void) {
+  DIAL_report[1] &= ~0x01;                      // release button
+  DIAL_sendReport();                            // send HID report
+}
+
+// Rotate dial (clockwise is positive)
+void DIAL_rotate(int16_t rot) {
+  DIAL_report[1] = (DIAL_report[1] & 0x01) | (uint8_t)(rot << 1);
+  DIAL_report[2] = (uint8_t)(rot >> 7);         // set relative rotation
+  DIAL_sendReport();                            // send HID report
+  DIAL_report[1] &= 0x01;                       // reset rotation
+  DIAL_report[2] = 0;
+}
+
+// ===================================================================================
+// Gamepad Functions
+// ===================================================================================
+
+// Report: 16 buttons, hat switch (4 bits, 8 = centered), 16-bit slider
+
+// Hat switch value for each combination of JOY_HAT_xxx (8 = centered)
+__code uint8_t JOY_hatMap[16] = {8, 0, 2, 1, 4, 8, 3, 2, 6, 7, 8, 0, 5, 6, 4, 8};
+
+// Press gamepad button(s)
+void JOY_press(uint16_t buttons) {
+  JOY_report[1] |= (uint8_t)buttons;            // press button(s)
+  JOY_report[2] |= (uint8_t)(buttons >> 8);
+  JOY_changed = 1;                              // sent by JOY_flush
+}
+
+// Release gamepad button(s)
+void JOY_release(uint16_t buttons) {
+  JOY_report[1] &= ~(uint8_t)buttons;           // release button(s)
+  JOY_report[2] &= ~(uint8_t)(buttons >> 8);
+  JOY_changed = 1;
+}
+
+// Press hat switch direction(s)
+void JOY_hatPress(uint8_t dirs) {
+  JOY_dirs |= dirs;
+  JOY_report[3] = JOY_hatMap[JOY_dirs & 0x0F];
+  JOY_changed = 1;
+}
+
+// Release hat switch direction(s)
+void JOY_hatRelease(uint8_t dirs) {
+  JOY_dirs &= ~dirs;
+  JOY_report[3] = JOY_hatMap[JOY_dirs & 0x0F];
+  JOY_changed = 1;
+}
+
+// Set slider axis
+void JOY_axis(int16_t value) {
+  JOY_report[4] = (uint8_t)value;               // set axis (little-endian)
+  JOY_report[5] = (uint8_t)((uint16_t)value >> 8);
+  JOY_changed = 1;
 }
 
-// Move joystick
-void JOY_move(int8_t xrel, int8_t yrel) {
-  JOY_report[2] = (uint8_t)xrel;                // set x-movement
-  JOY_report[3] = (uint8_t)yrel;                // set y-movement
+// Send report if it has changed (call once per frame)
+void JOY_flush(void) {
+  if(!JOY_changed) return;                      // no change
+  if(HID_busy()) {                              // EP1 busy: merge with later changes
+    TELE_count(coalesced);
+    return;
+  }
+  JOY_changed = 0;
   JOY_sendReport();                             // send HID report
 }
+
+// ===================================================================================
+// Feature Reports (called by USB interrupt)
+// ===================================================================================
+
+// Fill feature report buffer, reports of other IDs are handled by diagnostics
+uint8_t HID_getFeature(uint8_t id) {
+  if(id == 3) {                                 // mouse resolution multiplier
+    HID_featureBuf[0] = id;
+    HID_featureBuf[1] = MOUSE_resMult;
+    return 2;
+  }
+  return DIAG_getFeature(id);
+}
+
+// Handle feature report from host
+void HID_setFeature(uint8_t id, uint8_t len) {
+  if(id == 3) {                                 // mouse resolution multiplier
+    if(len >= 2) MOUSE_resMult = HID_featureBuf[1] & (MOUSE_RES_WHEEL | MOUSE_RES_PAN);
+    return;
+  }
+  DIAG_setFeature(id, len);
+}
@@ -13,27 +13,40 @@ void KBD_type(uint8_t key);                 // press and release a key on keyboa
 void KBD_releaseAll(void);                  // release all keys on keyboard
 void KBD_print(char* str);                  // type some text on the keyboard
 
-void CON_press(uint8_t key);                // press a consumer key on keyboard
-void CON_release(void);                     // release consumer key on keyboard
-void CON_type(uint8_t key);                 // press and release a consumer key
+void CON_press(uint16_t key);               // press a consumer key (16-bit usage)
+void CON_release(uint16_t key);             // release a consumer key
+void CON_type(uint16_t key);                // press and release a consumer key
+void CON_releaseAll(void);                  // release all consumer keys
+
+void SYS_press(uint8_t key);                // press a system control key
+void SYS_release(void);                     // release system control key
+void SYS_type(uint8_t key);                 // press and release a system control key
 
 void MOUSE_press(uint8_t buttons);          // press mouse button(s)
 void MOUSE_release(uint8_t buttons);        // release mouse button(s)
 void MOUSE_move(int8_t xrel, int8_t yrel);  // move mouse pointer (relative)
-void MOUSE_wheel(int8_t rel);               // move mouse wheel (relative)
+void MOUSE_wheel(int8_t rel);               // move mouse wheel (relative, detents)
+void MOUSE_pan(int8_t rel);                 // move horizontal wheel (relative, detents)
+void MOUSE_addMove(int8_t xrel, int8_t yrel);  // add pointer movement (sent by flush)
+void MOUSE_wheelHiRes(int8_t steps);        // add wheel movement (1/MOUSE_WHEEL_RES)
+void MOUSE_panHiRes(int8_t steps);          // add pan movement (1/MOUSE_WHEEL_RES)
+void MOUSE_flush(void);                     // send added movements (every tick)
+
+void DIAL_press(void);                      // press dial button
+void DIAL_release(void);                    // release dial button
+void DIAL_rotate(int16_t rot);              // rotate dial (1/10 degrees, clockwise > 0)
 
-void JOY_press(uint8_t buttons);            // press joystick button(s)
-void JOY_release(uint8_t buttons);          // release joystick button(s)
-void JOY_move(int8_t xrel, int8_t yrel);    // move joystick
+void JOY_press(uint16_t buttons);           // press gamepad button(s) (bit 0 = button 1)
+void JOY_release(uint16_t buttons);         // release gamepad button(s)
+void JOY_hatPress(uint8_t dirs);            // press hat switch direction(s) (JOY_HAT_xxx)
+void JOY_hatRelease(uint8_t dirs);          // release hat switch direction(s)
+void JOY_axis(int16_t value);               // set slider axis (-32767..32767)
+void JOY_flush(void);                       // send report if changed (every tick)
 
 #define MOUSE_wheel_up()        MOUSE_wheel( 1)
 #define MOUSE_wheel_down()      MOUSE_wheel(-1)
-
-#define JOY_center()            JOY_move(   0,   0)
-#define JOY_up()                JOY_move(   0,-127)
-#define JOY_down()              JOY_move(   0, 127)
-#define JOY_left()              JOY_move(-127,   0)
-#define JOY_right()             JOY_move( 127,   0)
+#define MOUSE_pan_left()        MOUSE_pan(-1)
+#define MOUSE_pan_right()       MOUSE_pan( 1)
 
 // Keyboard LED states
 #define KBD_getState()          (EP2_buffer[0]) 
@@ -94,7 +107,7 @@ void JOY_move(int8_t xrel, int8_t yrel);    // move joystick
 #define KBD_KEY_F23             0xFA
 #define KBD_KEY_F24             0xFB
 
-// Consumer Keyboard Keycodes
+// Consumer Keyboard Keycodes (16-bit usages of the consumer page)
 #define CON_SYS_POWER           0x30
 #define CON_SYS_RESET           0x31
 #define CON_SYS_SLEEP           0x32
@@ -113,6 +126,7 @@ void JOY_move(int8_t xrel, int8_t yrel);    // move joystick
 #define CON_MEDIA_STOP          0xB7
 #define CON_MEDIA_EJECT         0xB8
 #define CON_MEDIA_RANDOM        0xB9
+#define CON_MEDIA_PLAY_PAUSE    0xCD
 
 #define CON_MENU                0x40
 #define CON_MENU_PICK           0x41
@@ -124,7 +138,54 @@ void JOY_move(int8_t xrel, int8_t yrel);    // move joystick
 #define CON_MENU_INCR           0x47
 #define CON_MENU_DECR           0x48
 
+#define CON_AL_EMAIL            0x18A
+#define CON_AL_CALCULATOR       0x192
+#define CON_AL_FILE_BROWSER     0x194
+#define CON_AL_BROWSER          0x196
+
+#define CON_AC_SEARCH           0x221
+#define CON_AC_HOME             0x223
+#define CON_AC_BACK             0x224
+#define CON_AC_FORWARD          0x225
+#define CON_AC_STOP             0x226
+#define CON_AC_REFRESH          0x227
+#define CON_AC_BOOKMARKS        0x22A
+
+// System Control Keys (usages of the generic desktop page). If the host is
+// sleeping, any system control key wakes it up (if allowed by the host) and is not
+// sent, so the key which puts the host to sleep also wakes it up again.
+#define SYS_POWER_DOWN          0x81
+#define SYS_SLEEP               0x82
+#define SYS_WAKE_UP             0x83
+#define SYS_DISPLAY_INVERT      0xB0
+#define SYS_DISPLAY_INTERNAL    0xB1
+#define SYS_DISPLAY_EXTERNAL    0xB2
+#define SYS_DISPLAY_BOTH        0xB3
+#define SYS_DISPLAY_DUAL        0xB4
+#define SYS_DISPLAY_TOGGLE      0xB5
+#define SYS_DISPLAY_SWAP        0xB6
+
 // Mouse Buttons
 #define MOUSE_BUTTON_LEFT       0x01
 #define MOUSE_BUTTON_RIGHT      0x02
 #define MOUSE_BUTTON_MIDDLE     0x04
+
+// Mouse Wheel Resolution Multiplier (feature report ID 3, set by the host). While
+// a multiplier is active, the host expects MOUSE_WHEEL_RES steps per detent. The
+// hi-res functions and MOUSE_addMove add up steps, MOUSE_flush sends them once per
+// frame as far as the host resolution allows and keeps the remainder for the next
+// report.
+#define MOUSE_RES_WHEEL         0x03        // wheel multiplier (bits 0-1)
+#define MOUSE_RES_PAN           0x0C        // pan multiplier (bits 2-3)
+
+extern volatile uint8_t MOUSE_resMult;      // multipliers set by host (MOUSE_RES_xxx)
+
+// Gamepad (report ID 4). The functions only change the state, JOY_flush sends it
+// once per frame if it has changed, so the gamepad reports at up to 1 kHz. The
+// hat switch shows the combination of the pressed directions (opposite directions
+// cancel each other out).
+#define JOY_BUTTON(n)           (1U << ((n) - 1)) // button 1..16
+#define JOY_HAT_UP              0x01
+#define JOY_HAT_RIGHT           0x02
+#define JOY_HAT_DOWN            0x04
+#define JOY_HAT_LEFT            0x08
@@ -10,7 +10,11 @@
 __code USB_DEV_DESCR DevDescr = {
   .bLength            = sizeof(DevDescr),       // size of the descriptor in bytes: 18
   .bDescriptorType    = USB_DESCR_TYP_DEVICE,   // device descriptor: 0x01
+  #ifdef RAW_WINUSB
+  .bcdUSB             = 0x0201,                 // USB 2.01: host reads BOS descriptor
+  #else
   .bcdUSB             = 0x0110,                 // USB specification: USB 1.1
+  #endif
   .bDeviceClass       = 0,                      // interface will define class
   .bDeviceSubClass    = 0,                      // unused
   .bDeviceProtocol    = 0,                      // unused
@@ -24,6 +28,264 @@ __code USB_DEV_DESCR DevDescr = {
   .bNumConfigurations = 1                       // number of possible configurations
 };
 
+// ===================================================================================
+// HID Report Descriptor
+// ===================================================================================
+// Defined before the configuration descriptor, which needs its size.
+__code uint8_t ReportDescr[] ={
+  // Standard keyboard
+  0x05, 0x01,           // USAGE_PAGE (Generic Desktop)
+  0x09, 0x06,           // USAGE (Keyboard)
+  0xa1, 0x01,           // COLLECTION (Application)
+  0x85, 0x01,           //   REPORT_ID (1)
+  0x05, 0x07,           //   USAGE_PAGE (Keyboard)
+  0x19, 0xe0,           //   USAGE_MINIMUM (Keyboard LeftControl)
+  0x29, 0xe7,           //   USAGE_MAXIMUM (Keyboard Right GUI)
+  0x15, 0x00,           //   LOGICAL_MINIMUM (0)
+  0x25, 0x01,           //   LOGICAL_MAXIMUM (1)
+  0x75, 0x01,           //   REPORT_SIZE (1)
+  0x95, 0x08,           //   REPORT_COUNT (8)
+  0x81, 0x02,           //   INPUT (Data,Var,Abs)
+  0x75, 0x08,           //   REPORT_SIZE (8)
+  0x95, 0x01,           //   REPORT_COUNT (1)
+  0x81, 0x03,           //   INPUT (Cnst,Var,Abs)
+  0x19, 0x00,           //   USAGE_MINIMUM (Reserved (no event indicated))
+  0x29, 0xe7,           //   USAGE_MAXIMUM (Keyboard Right GUI)
+  0x15, 0x00,           //   LOGICAL_MINIMUM (0)
+  0x26, 0xff, 0x00,     //   LOGICAL_MAXIMUM (255)
+  0x75, 0x08,           //   REPORT_SIZE (8)
+  0x95, 0x05,           //   REPORT_COUNT (5)
+  0x81, 0x00,           //   INPUT (Data,Ary,Abs)
+  0x05, 0x08,           //   USAGE_PAGE (LEDs)
+  0x19, 0x01,           //   USAGE_MINIMUM (Num Lock)
+  0x29, 0x05,           //   USAGE_MAXIMUM (Kana)
+  0x15, 0x00,           //   LOGICAL_MINIMUM (0)
+  0x25, 0x01,           //   LOGICAL_MAXIMUM (1)
+  0x75, 0x01,           //   REPORT_SIZE (1)
+  0x95, 0x05,           //   REPORT_COUNT (5)
+  0x91, 0x02,           //   OUTPUT (Data,Var,Abs)
+  0x75, 0x03,           //   REPORT_SIZE (3)
+  0x95, 0x01,           //   REPORT_COUNT (1)
+  0x91, 0x03,           //   OUTPUT (Cnst,Var,Abs)
+  0xc0,                 // END_COLLECTION
+
+  // Consumer multimedia keyboard
+  0x05, 0x0c,           // USAGE_PAGE (Consumer Devices)
+  0x09, 0x01,           // USAGE (Consumer Control)
+  0xa1, 0x01,           // COLLECTION (Application)
+  0x85, 0x02,           //   REPORT_ID (2)
+  0x19, 0x00,           //   USAGE_MINIMUM (Unassigned)
+  0x2a, 0x3c, 0x02,     //   USAGE_MAXIMUM (AC Format)
+  0x15, 0x00,           //   LOGICAL_MINIMUM (0)
+  0x26, 0x3c, 0x02,     //   LOGICAL_MAXIMUM (572)
+  0x75, 0x10,           //   REPORT_SIZE (16)
+  0x95, CON_SLOTS,      //   REPORT_COUNT (CON_SLOTS)
+  0x81, 0x00,           //   INPUT (Data,Ary,Abs)
+  0xc0,                 // END_COLLECTION
+
+  // System control (power down, sleep, wake up, display mode)
+  0x05, 0x01,           // USAGE_PAGE (Generic Desktop)
+  0x09, 0x80,           // USAGE (System Control)
+  0xa1, 0x01,           // COLLECTION (Application)
+  0x85, 0x05,           //   REPORT_ID (5)
+  0x19, 0x81,           //   USAGE_MINIMUM (System Power Down)
+  0x29, 0xb7,           //   USAGE_MAXIMUM (System Display LCD Autoscale)
+  0x16, 0x81, 0x00,     //   LOGICAL_MINIMUM (129)
+  0x26, 0xb7, 0x00,     //   LOGICAL_MAXIMUM (183)
+  0x75, 0x08,           //   REPORT_SIZE (8)
+  0x95, 0x01,           //   REPORT_COUNT (1)
+  0x81, 0x00,           //   INPUT (Data,Ary,Abs)
+  0xc0,                 // END_COLLECTION
+
+  // Radial controller (dial with button, rotation in 1/10 degrees)
+  0x05, 0x01,           // USAGE_PAGE (Generic Desktop)
+  0x09, 0x0e,           // USAGE (System Multi-Axis Controller)
+  0xa1, 0x01,           // COLLECTION (Application)
+  0x85, 0x06,           //   REPORT_ID (6)
+  0x05, 0x0d,           //   USAGE_PAGE (Digitizers)
+  0x09, 0x21,           //   USAGE (Puck)
+  0xa1, 0x00,           //   COLLECTION (Physical)
+  0x05, 0x09,           //     USAGE_PAGE (Button)
+  0x09, 0x01,           //     USAGE (Button 1)
+  0x15, 0x00,           //     LOGICAL_MINIMUM (0)
+  0x25, 0x01,           //     LOGICAL_MAXIMUM (1)
+  0x75, 0x01,           //     REPORT_SIZE (1)
+  0x95, 0x01,           //     REPORT_COUNT (1)
+  0x81, 0x02,           //     INPUT (Data,Var,Abs)
+  0x05, 0x01,           //     USAGE_PAGE (Generic Desktop)
+  0x09, 0x37,           //     USAGE (Dial)
+  0x16, 0xf0, 0xf1,     //     LOGICAL_MINIMUM (-3600)
+  0x26, 0x10, 0x0e,     //     LOGICAL_MAXIMUM (3600)
+  0x36, 0xf0, 0xf1,     //     PHYSICAL_MINIMUM (-3600)
+  0x46, 0x10, 0x0e,     //     PHYSICAL_MAXIMUM (3600)
+  0x55, 0x0f,           //     UNIT_EXPONENT (-1)
+  0x65, 0x14,           //     UNIT (Eng Rot: Degrees)
+  0x75, 0x0f,           //     REPORT_SIZE (15)
+  0x81, 0x06,           //     INPUT (Data,Var,Rel)
+  0x55, 0x00,           //     UNIT_EXPONENT (0)
+  0x65, 0x00,           //     UNIT (None)
+  0x35, 0x00,           //     PHYSICAL_MINIMUM (0)
+  0x45, 0x00,           //     PHYSICAL_MAXIMUM (0)
+  0xc0,                 //   END_COLLECTION
+  0xc0,                 // END_COLLECTION
+
+  // Vendor-defined diagnostics (feature reports, see diag.h)
+  0x06, 0x00, 0xff,     // USAGE_PAGE (Vendor Defined Page 1)
+  0x09, 0x01,           // USAGE (Vendor Usage 1)
+  0xa1, 0x01,           // COLLECTION (Application)
+  0x15, 0x00,           //   LOGICAL_MINIMUM (0)
+  0x26, 0xff, 0x00,     //   LOGICAL_MAXIMUM (255)
+  0x75, 0x08,           //   REPORT_SIZE (8)
+  0x85, 0x10,           //   REPORT_ID (16)
+  0x09, 0x10,           //   USAGE (Oscillator Calibration)
+  0x95, 0x07,           //   REPORT_COUNT (7)
+  0xb1, 0x02,           //   FEATURE (Data,Var,Abs)
+  0x85, 0x11,           //   REPORT_ID (17)
+  0x09, 0x11,           //   USAGE (Latency Histogram)
+  0x95, 0x24,           //   REPORT_COUNT (36)
+  0xb1, 0x02,           //   FEATURE (Data,Var,Abs)
+  #ifdef PROF_ENABLE
+  0x85, 0x12,           //   REPORT_ID (18)
+  0x09, 0x12,           //   USAGE (Section Profiler)
+  0x95, 0x78,           //   REPORT_COUNT (120)
+  0xb1, 0x02,           //   FEATURE (Data,Var,Abs)
+  #endif
+  #ifdef TRACE_ENABLE
+  0x85, 0x13,           //   REPORT_ID (19)
+  0x09, 0x13,           //   USAGE (Input Event Trace)
+  0x95, 0x44,           //   REPORT_COUNT (68)
+  0xb1, 0x02,           //   FEATURE (Data,Var,Abs)
+  #endif
+  0x85, 0x14,           //   REPORT_ID (20)
+  0x09, 0x14,           //   USAGE (Transport Telemetry)
+  0x95, 0x13,           //   REPORT_COUNT (19)
+  0xb1, 0x02,           //   FEATURE (Data,Var,Abs)
+  0x85, 0x15,           //   REPORT_ID (21)
+  0x09, 0x15,           //   USAGE (Bootloader Entry)
+  0x95, 0x04,           //   REPORT_COUNT (4)
+  0xb1, 0x02,           //   FEATURE (Data,Var,Abs)
+  0xc0,                 // END_COLLECTION
+
+  // Mouse with 3 buttons, high-resolution wheel and AC Pan
+  0x05, 0x01,           // USAGE_PAGE (Generic Desktop)
+  0x09, 0x02,           // USAGE (Mouse)
+  0xa1, 0x01,           // COLLECTION (Application)
+  0x09, 0x01,           //   USAGE (Pointer)
+  0xa1, 0x00,           //   COLLECTION (Physical)
+  0x85, 0x03,           //     REPORT_ID (3)
+  0x05, 0x09,           //     USAGE_PAGE (Button)
+  0x19, 0x01,           //     USAGE_MINIMUM (Button 1)
+  0x29, 0x03,           //     USAGE_MAXIMUM (Button 3)
+  0x15, 0x00,           //     LOGICAL_MINIMUM (0)
+  0x25, 0x01,           //     LOGICAL_MAXIMUM (1)
+  0x75, 0x01,           //     REPORT_SIZE (1)
+  0x95, 0x03,           //     REPORT_COUNT (3)
+  0x81, 0x02,           //     INPUT (Data,Var,Abs)
+  0x75, 0x05,           //     REPORT_SIZE (5)
+  0x95, 0x01,           //     REPORT_COUNT (1)
+  0x81, 0x03,           //     INPUT (Cnst,Var,Abs)
+  0x05, 0x01,           //     USAGE_PAGE (Generic Desktop)
+  0x09, 0x30,           //     USAGE (X)
+  0x09, 0x31,           //     USAGE (Y)
+  0x15, 0x81,           //     LOGICAL_MINIMUM (-127)
+  0x25, 0x7f,           //     LOGICAL_MAXIMUM (127)
+  0x75, 0x08,           //     REPORT_SIZE (8)
+  0x95, 0x02,           //     REPORT_COUNT (2)
+  0x81, 0x06,           //     INPUT (Data,Var,Rel)
+  0xa1, 0x02,           //     COLLECTION (Logical)
+  0x09, 0x48,           //       USAGE (Resolution Multiplier)
+  0x15, 0x00,           //       LOGICAL_MINIMUM (0)
+  0x25, 0x01,           //       LOGICAL_MAXIMUM (1)
+  0x35, 0x01,           //       PHYSICAL_MINIMUM (1)
+  0x45, MOUSE_WHEEL_RES,//       PHYSICAL_MAXIMUM (MOUSE_WHEEL_RES)
+  0x75, 0x02,           //       REPORT_SIZE (2)
+  0x95, 0x01,           //       REPORT_COUNT (1)
+  0xa4,                 //       PUSH
+  0xb1, 0x02,           //       FEATURE (Data,Var,Abs)
+  0x09, 0x38,           //       USAGE (Wheel)
+  0x15, 0x81,           //       LOGICAL_MINIMUM (-127)
+  0x25, 0x7f,           //       LOGICAL_MAXIMUM (127)
+  0x35, 0x00,           //       PHYSICAL_MINIMUM (0)
+  0x45, 0x00,           //       PHYSICAL_MAXIMUM (0)
+  0x75, 0x08,           //       REPORT_SIZE (8)
+  0x81, 0x06,           //       INPUT (Data,Var,Rel)
+  0xc0,                 //     END_COLLECTION
+  0xa1, 0x02,           //     COLLECTION (Logical)
+  0x09, 0x48,           //       USAGE (Resolution Multiplier)
+  0xb4,                 //       POP
+  0xb1, 0x02,           //       FEATURE (Data,Var,Abs)
+  0x35, 0x00,           //       PHYSICAL_MINIMUM (0)
+  0x45, 0x00,           //       PHYSICAL_MAXIMUM (0)
+  0x75, 0x04,           //       REPORT_SIZE (4)
+  0xb1, 0x03,           //       FEATURE (Cnst,Var,Abs)
+  0x05, 0x0c,           //       USAGE_PAGE (Consumer Devices)
+  0x0a, 0x38, 0x02,     //       USAGE (AC Pan)
+  0x15, 0x81,           //       LOGICAL_MINIMUM (-127)
+  0x25, 0x7f,           //       LOGICAL_MAXIMUM (127)
+  0x75, 0x08,           //       REPORT_SIZE (8)
+  0x81, 0x06,           //       INPUT (Data,Var,Rel)
+  0xc0,                 //     END_COLLECTION
+  0xc0,                 //   END_COLLECTION
+  0xc0,                 // END_COLLECTION
+
+  // Gamepad with 16 buttons, hat switch and 16-bit slider
+  0x05, 0x01,           // USAGE_PAGE (Generic Desktop)
+  0x09, 0x05,           // USAGE (Game Pad)
+  0xa1, 0x01,           // COLLECTION (Application)
+  0x85, 0x04,           //   REPORT_ID (4)
+  0x05, 0x09,           //   USAGE_PAGE (Button)
+  0x19, 0x01,           //   USAGE_MINIMUM (Button 1)
+  0x29, 0x10,           //   USAGE_MAXIMUM (Button 16)
+  0x15, 0x00,           //   LOGICAL_MINIMUM (0)
+  0x25, 0x01,           //   LOGICAL_MAXIMUM (1)
+  0x75, 0x01,           //   REPORT_SIZE (1)
+  0x95, 0x10,           //   REPORT_COUNT (16)
+  0x81, 0x02,           //   INPUT (Data,Var,Abs)
+  0x05, 0x01,           //   USAGE_PAGE (Generic Desktop)
+  0x09, 0x39,           //   USAGE (Hat switch)
+  0x25, 0x07,           //   LOGICAL_MAXIMUM (7)
+  0x35, 0x00,           //   PHYSICAL_MINIMUM (0)
+  0x46, 0x3b, 0x01,     //   PHYSICAL_MAXIMUM (315)
+  0x65, 0x14,           //   UNIT (Eng Rot: Degrees)
+  0x75, 0x04,           //   REPORT_SIZE (4)
+  0x95, 0x01,           //   REPORT_COUNT (1)
+  0x81, 0x42,           //   INPUT (Data,Var,Abs,Null)
+  0x65, 0x00,           //   UNIT (None)
+  0x45, 0x00,           //   PHYSICAL_MAXIMUM (0)
+  0x81, 0x03,           //   INPUT (Cnst,Var,Abs)
+  0x09, 0x36,           //   USAGE (Slider)
+  0x16, 0x01, 0x80,     //   LOGICAL_MINIMUM (-32767)
+  0x26, 0xff, 0x7f,     //   LOGICAL_MAXIMUM (32767)
+  0x75, 0x10,           //   REPORT_SIZE (16)
+  0x81, 0x02,           //   INPUT (Data,Var,Abs)
+  0xc0                  // END_COLLECTION
+};
+
+__code uint16_t ReportDescrLen = sizeof(ReportDescr);
+
+#if defined(RAW_ENABLE) && !defined(RAW_WINUSB)
+// Raw HID interface: 64 bytes in each direction without report ID (the usage page
+// and usages are the ones of the QMK raw HID, so host tools can find it)
+__code uint8_t RawReportDescr[] ={
+  0x06, 0x60, 0xff,     // USAGE_PAGE (Vendor Defined 0xFF60)
+  0x09, 0x61,           // USAGE (Vendor Usage 0x61)
+  0xa1, 0x01,           // COLLECTION (Application)
+  0x09, 0x62,           //   USAGE (Vendor Usage 0x62)
+  0x15, 0x00,           //   LOGICAL_MINIMUM (0)
+  0x26, 0xff, 0x00,     //   LOGICAL_MAXIMUM (255)
+  0x75, 0x08,           //   REPORT_SIZE (8)
+  0x95, EP4_SIZE,       //   REPORT_COUNT (64)
+  0x81, 0x02,           //   INPUT (Data,Var,Abs)
+  0x09, 0x63,           //   USAGE (Vendor Usage 0x63)
+  0x15, 0x00,           //   LOGICAL_MINIMUM (0)
+  0x26, 0xff, 0x00,     //   LOGICAL_MAXIMUM (255)
+  0x75, 0x08,           //   REPORT_SIZE (8)
+  0x95, EP4_SIZE,       //   REPORT_COUNT (64)
+  0x91, 0x02,           //   OUTPUT (Data,Var,Abs)
+  0xc0                  // END_COLLECTION
+};
+#endif
+
 // ===================================================================================
 // Configuration Descriptor
 // ===================================================================================
@@ -34,10 +296,16 @@ __code USB_CFG_DESCR_HID CfgDescr = {
     .bLength            = sizeof(USB_CFG_DESCR),  // size of the descriptor in bytes
     .bDescriptorType    = USB_DESCR_TYP_CONFIG,   // configuration descriptor: 0x02
     .wTotalLength       = sizeof(CfgDescr),       // total length in bytes
+    #ifdef MIDI_ENABLE
+    .bNumInterfaces     = 3,                      // HID, audio control, MIDI streaming
+    #elif defined(RAW_ENABLE)
+    .bNumInterfaces     = 2,                      // HID, raw HID
+    #else
     .bNumInterfaces     = 1,                      // number of interfaces: 1
+    #endif
     .bConfigurationValue= 1,                      // value to select this configuration
     .iConfiguration     = 0,                      // no configuration string descriptor
-    .bmAttributes       = 0x80,                   // attributes = bus powered, no wakeup
+    .bmAttributes       = 0xa0,                   // attributes = bus powered, remote wakeup
     .MaxPower           = USB_MAX_POWER_mA / 2    // in 2mA units
   },
 
@@ -83,141 +351,382 @@ __code USB_CFG_DESCR_HID CfgDescr = {
     .bmAttributes       = USB_ENDP_TYPE_INTER,    // transfer type: interrupt (0x03)
     .wMaxPacketSize     = EP2_SIZE,               // max packet size
     .bInterval          = 10                      // polling intervall in ms
-  }
-};
+  },
 
-// ===================================================================================
-// HID Report Descriptor
-// ===================================================================================
-__code uint8_t ReportDescr[] ={
-  // Standard keyboard
-  0x05, 0x01,           // USAGE_PAGE (Generic Desktop)
-  0x09, 0x06,           // USAGE (Keyboard)
-  0xa1, 0x01,           // COLLECTION (Application)
-  0x85, 0x01,           //   REPORT_ID (1)
-  0x05, 0x07,           //   USAGE_PAGE (Keyboard)
-  0x19, 0xe0,           //   USAGE_MINIMUM (Keyboard LeftControl)
-  0x29, 0xe7,           //   USAGE_MAXIMUM (Keyboard Right GUI)
-  0x15, 0x00,           //   LOGICAL_MINIMUM (0)
-  0x25, 0x01,           //   LOGICAL_MAXIMUM (1)
-  0x75, 0x01,           //   REPORT_SIZE (1)
-  0x95, 0x08,           //   REPORT_COUNT (8)
-  0x81, 0x02,           //   INPUT (Data,Var,Abs)
-  0x75, 0x08,           //   REPORT_SIZE (8)
-  0x95, 0x01,           //   REPORT_COUNT (1)
-  0x81, 0x03,           //   INPUT (Cnst,Var,Abs)
-  0x19, 0x00,           //   USAGE_MINIMUM (Reserved (no event indicated))
-  0x29, 0xe7,           //   USAGE_MAXIMUM (Keyboard Right GUI)
-  0x15, 0x00,           //   LOGICAL_MINIMUM (0)
-  0x26, 0xff, 0x00,     //   LOGICAL_MAXIMUM (255)
-  0x75, 0x08,           //   REPORT_SIZE (8)
-  0x95, 0x05,           //   REPORT_COUNT (5)
-  0x81, 0x00,           //   INPUT (Data,Ary,Abs)
-  0x05, 0x08,           //   USAGE_PAGE (LEDs)
-  0x19, 0x01,           //   USAGE_MINIMUM (Num Lock)
-  0x29, 0x05,           //   USAGE_MAXIMUM (Kana)
-  0x15, 0x00,           //   LOGICAL_MINIMUM (0)
-  0x25, 0x01,           //   LOGICAL_MAXIMUM (1)
-  0x75, 0x01,           //   REPORT_SIZE (1)
-  0x95, 0x05,           //   REPORT_COUNT (5)
-  0x91, 0x02,           //   OUTPUT (Data,Var,Abs)
-  0x75, 0x03,           //   REPORT_SIZE (3)
-  0x95, 0x01,           //   REPORT_COUNT (1)
-  0x91, 0x03,           //   OUTPUT (Cnst,Var,Abs)
-  0xc0,                 // END_COLLECTION
+  #ifdef MIDI_ENABLE
+  // Interface Descriptor: Audio Control (required for MIDI streaming)
+  .interface1 = {
+    .bLength            = sizeof(USB_ITF_DESCR),  // size of the descriptor in bytes: 9
+    .bDescriptorType    = USB_DESCR_TYP_INTERF,   // interface descriptor: 0x04
+    .bInterfaceNumber   = 1,                      // number of this interface: 1
+    .bAlternateSetting  = 0,                      // value used to select alternative setting
+    .bNumEndpoints      = 0,                      // no endpoints
+    .bInterfaceClass    = USB_DEV_CLASS_AUDIO,    // interface class: audio (0x01)
+    .bInterfaceSubClass = USB_AUDIO_SUBCL_CONTROL,// audio control (0x01)
+    .bInterfaceProtocol = 0,                      // unused
+    .iInterface         = 0                       // no interface string descriptor
+  },
 
-  // Consumer multimedia keyboard
-  0x05, 0x0c,           // USAGE_PAGE (Consumer Devices)
-  0x09, 0x01,           // USAGE (Consumer Control)
-  0xa1, 0x01,           // COLLECTION (Application)
-  0x85, 0x02,           //   REPORT_ID (2)
-  0x19, 0x00,           //   USAGE_MINIMUM (Unassigned)
-  0x2a, 0x3c, 0x02,     //   USAGE_MAXIMUM (AC Format)
-  0x15, 0x00,           //   LOGICAL_MINIMUM (0)
-  0x26, 0x3c, 0x02,     //   LOGICAL_MAXIMUM (572)
-  0x75, 0x10,           //   REPORT_SIZE (16)
-  0x95, 0x01,           //   REPORT_COUNT (1)
-  0x81, 0x00,           //   INPUT (Data,Var,Abs)
-  0xc0,                 // END_COLLECTION
+  // Class-specific Audio Control Interface Header
+  .acHeader = {
+    .bLength            = sizeof(USB_AC_HEADER_DESCR),  // size of the descriptor: 9
+    .bDescriptorType    = USB_DESCR_TYP_CS_INTF,  // class-specific interface: 0x24
+    .bDescriptorSubtype = 0x01,                   // header
+    .bcdADC             = 0x0100,                 // audio class spec version (BCD: 1.0)
+    .wTotalLength       = sizeof(USB_AC_HEADER_DESCR),  // class-specific descriptors
+    .bInCollection      = 1,                      // number of streaming interfaces: 1
+    .baInterfaceNr      = 2                       // MIDI streaming interface: 2
+  },
 
-  // Mouse with wheel and 3 buttons
-  // 0x05, 0x01,           // USAGE_PAGE (Generic Desktop)
-  // 0x09, 0x02,           // USAGE (Mouse)
-  // 0xa1, 0x01,           // COLLECTION (Application)
-  // 0x09, 0x01,           //   USAGE (Pointer)
-  // 0xa1, 0x00,           //   COLLECTION (Physical)
-  // 0x85, 0x03,           //     REPORT_ID (3)
-  // 0x05, 0x09,           //     USAGE_PAGE (Button)
-  // 0x19, 0x01,           //     USAGE_MINIMUM (Button 1)
-  // 0x29, 0x03,           //     USAGE_MAXIMUM (Button 3)
-  // 0x15, 0x00,           //     LOGICAL_MINIMUM (0)
-  // 0x25, 0x01,           //     LOGICAL_MAXIMUM (1)
-  // 0x75, 0x01,           //     REPORT_SIZE (1)
-  // 0x95, 0x03,           //     REPORT_COUNT (3)
-  // 0x81, 0x02,           //     INPUT (Data,Var,Abs)
-  // 0x75, 0x05,           //     REPORT_SIZE (5)
-  // 0x95, 0x01,           //     REPORT_COUNT (1)
-  // 0x81, 0x03,           //     INPUT (Cnst,Var,Abs)
-  // 0x05, 0x01,           //     USAGE_PAGE (Generic Desktop)
-  // 0x09, 0x30,           //     USAGE (X)
-  // 0x09, 0x31,           //     USAGE (Y)
-  // 0x09, 0x38,           //     USAGE (Wheel)
-  // 0x15, 0x81,           //     LOGICAL_MINIMUM (-127)
-  // 0x25, 0x7f,           //     LOGICAL_MAXIMUM (127)
-  // 0x75, 0x08,           //     REPORT_SIZE (8)
-  // 0x95, 0x03,           //     REPORT_COUNT (3)
-  // 0x81, 0x06,           //     INPUT (Data,Var,Rel)
-  // 0xc0,                 //   END_COLLECTION
-  // 0xc0,                 // END_COLLECTION
-
-  // Joystick with 8 buttons
-	// 0x05, 0x01,           // USAGE_PAGE (Generic Desktop)
-	// 0x09, 0x05,           // USAGE (Game Pad)
-	// 0xa1, 0x01,           // COLLECTION (Application)
-	// 0xa1, 0x00,           //   COLLECTION (Physical)
-  // 0x85, 0x04,           //     REPORT_ID (4)
-	// 0x05, 0x09,           //     USAGE_PAGE (Button)
-	// 0x19, 0x01,           //     USAGE_MINIMUM (Button 1)
-	// 0x29, 0x08,           //     USAGE_MAXIMUM (Button 8)
-	// 0x15, 0x00,           //     LOGICAL_MINIMUM (0)
-	// 0x25, 0x01,           //     LOGICAL_MAXIMUM (1)
-	// 0x75, 0x01,           //     REPORT_SIZE (1)
-	// 0x95, 0x08,           //     REPORT_COUNT (8)
-	// 0x81, 0x02,           //     INPUT (Data,Var,Abs)
-  // 0x05, 0x01,           //     USAGE_PAGE (Generic Desktop)
-	// 0x09, 0x30,           //     USAGE (X)
-	// 0x09, 0x31,           //     USAGE (Y)
-  // 0x15, 0x81,           //     LOGICAL_MINIMUM (-127)
-  // 0x25, 0x7f,           //     LOGICAL_MAXIMUM (127)
-	// 0x75, 0x08,           //     REPORT_SIZE (8)
-	// 0x95, 0x02,           //     REPORT_COUNT (2)
-	// 0x81, 0x02,           //     INPUT (Data,Var,Abs)
-	// 0xc0,                 //   END_COLLECTION
-	// 0xc0                  // END_COLLECTION
-};
+  // Interface Descriptor: MIDI Streaming
+  .interface2 = {
+    .bLength            = sizeof(USB_ITF_DESCR),  // size of the descriptor in bytes: 9
+    .bDescriptorType    = USB_DESCR_TYP_INTERF,   // interface descriptor: 0x04
+    .bInterfaceNumber   = 2,                      // number of this interface: 2
+    .bAlternateSetting  = 0,                      // value used to select alternative setting
+    .bNumEndpoints      = 2,                      // number of endpoints used: 2
+    .bInterfaceClass    = USB_DEV_CLASS_AUDIO,    // interface class: audio (0x01)
+    .bInterfaceSubClass = USB_AUDIO_SUBCL_MIDI,   // MIDI streaming (0x03)
+    .bInterfaceProtocol = 0,                      // unused
+    .iInterface         = 0                       // no interface string descriptor
+  },
 
-__code uint8_t ReportDescrLen = sizeof(ReportDescr);
+  // Class-specific MIDI Streaming Interface Header
+  .msHeader = {
+    .bLength            = sizeof(USB_MS_HEADER_DESCR),  // size of the descriptor: 7
+    .bDescriptorType    = USB_DESCR_TYP_CS_INTF,  // class-specific interface: 0x24
+    .bDescriptorSubtype = 0x01,                   // header
+    .bcdMSC             = 0x0100,                 // MIDI class spec version (BCD: 1.0)
+    .wTotalLength       = sizeof(USB_MS_HEADER_DESCR)     // this header, jacks and
+                        + 2 * sizeof(USB_MIDI_IN_JACK_DESCR)  // endpoints: 65
+                        + 2 * sizeof(USB_MIDI_OUT_JACK_DESCR)
+                        + 2 * sizeof(USB_AUDIO_ENDP_DESCR)
+                        + 2 * sizeof(USB_MS_ENDP_DESCR)
+  },
+
+  // MIDI IN Jacks: embedded (from host) and external (from the pad)
+  .jackInEmb = {
+    .bLength            = sizeof(USB_MIDI_IN_JACK_DESCR), // size of the descriptor: 6
+    .bDescriptorType    = USB_DESCR_TYP_CS_INTF,  // class-specific interface: 0x24
+    .bDescriptorSubtype = 0x02,                   // MIDI IN jack
+    .bJackType          = USB_MIDI_JACK_EMBEDDED,
+    .bJackID            = 1,
+    .iJack              = 0
+  },
+  .jackInExt = {
+    .bLength            = sizeof(USB_MIDI_IN_JACK_DESCR), // size of the descriptor: 6
+    .bDescriptorType    = USB_DESCR_TYP_CS_INTF,  // class-specific interface: 0x24
+    .bDescriptorSubtype = 0x02,                   // MIDI IN jack
+    .bJackType          = USB_MIDI_JACK_EXTERNAL,
+    .bJackID            = 2,
+    .iJack              = 0
+  },
+
+  // MIDI OUT Jacks: embedded (to host, from jack 2) and external (from jack 1)
+  .jackOutEmb = {
+    .bLength            = sizeof(USB_MIDI_OUT_JACK_DESCR),  // size of the descriptor: 9
+    .bDescriptorType    = USB_DESCR_TYP_CS_INTF,  // class-specific interface: 0x24
+    .bDescriptorSubtype = 0x03,                   // MIDI OUT jack
+    .bJackType          = USB_MIDI_JACK_EMBEDDED,
+    .bJackID            = 3,
+    .bNrInputPins       = 1,
+    .baSourceID         = 2,
+    .baSourcePin        = 1,
+    .iJack              = 0
+  },
+  .jackOutExt = {
+    .bLength            = sizeof(USB_MIDI_OUT_JACK_DESCR),  // size of the descriptor: 9
+    .bDescriptorType    = USB_DESCR_TYP_CS_INTF,  // class-specific interface: 0x24
+    .bDescriptorSubtype = 0x03,                   // MIDI OUT jack
+    .bJackType          = USB_MIDI_JACK_EXTERNAL,
+    .bJackID            = 4,
+    .bNrInputPins       = 1,
+    .baSourceID         = 1,
+    .baSourcePin        = 1,
+    .iJack              = 0
+  },
+
+  // Endpoint Descriptor: Endpoint 3 (OUT, Bulk)
+  .ep3OUT = {
+    .bLength            = sizeof(USB_AUDIO_ENDP_DESCR), // size of the descriptor: 9
+    .bDescriptorType    = USB_DESCR_TYP_ENDP,     // endpoint descriptor: 0x05
+    .bEndpointAddress   = USB_ENDP_ADDR_EP3_OUT,  // endpoint: 3, direction: OUT (0x03)
+    .bmAttributes       = USB_ENDP_TYPE_BULK,     // transfer type: bulk (0x02)
+    .wMaxPacketSize     = EP3_SIZE,               // max packet size
+    .bInterval          = 0,                      // unused for bulk
+    .bRefresh           = 0,
+    .bSynchAddress      = 0
+  },
+  .ep3OUTms = {
+    .bLength            = sizeof(USB_MS_ENDP_DESCR),  // size of the descriptor: 5
+    .bDescriptorType    = USB_DESCR_TYP_CS_ENDP,  // class-specific endpoint: 0x25
+    .bDescriptorSubtype = 0x01,                   // general
+    .bNumEmbMIDIJack    = 1,
+    .baAssocJackID      = 1                       // embedded IN jack
+  },
+
+  // Endpoint Descriptor: Endpoint 3 (IN, Bulk)
+  .ep3IN = {
+    .bLength            = sizeof(USB_AUDIO_ENDP_DESCR), // size of the descriptor: 9
+    .bDescriptorType    = USB_DESCR_TYP_ENDP,     // endpoint descriptor: 0x05
+    .bEndpointAddress   = USB_ENDP_ADDR_EP3_IN,   // endpoint: 3, direction: IN (0x83)
+    .bmAttributes       = USB_ENDP_TYPE_BULK,     // transfer type: bulk (0x02)
+    .wMaxPacketSize     = EP3_SIZE,               // max packet size
+    .bInterval          = 0,                      // unused for bulk
+    .bRefresh           = 0,
+    .bSynchAddress      = 0
+  },
+  .ep3INms = {
+    .bLength            = sizeof(USB_MS_ENDP_DESCR),  // size of the descriptor: 5
+    .bDescriptorType    = USB_DESCR_TYP_CS_ENDP,  // class-specific endpoint: 0x25
+    .bDescriptorSubtype = 0x01,                   // general
+    .bNumEmbMIDIJack    = 1,
+    .baAssocJackID      = 3                       // embedded OUT jack
+  },
+  #endif
+
+  #ifdef RAW_ENABLE
+  // Interface Descriptor: Raw HID (vendor class with RAW_WINUSB)
+  .interface1 = {
+    .bLength            = sizeof(USB_ITF_DESCR),  // size of the descriptor in bytes: 9
+    .bDescriptorType    = USB_DESCR_TYP_INTERF,   // interface descriptor: 0x04
+    .bInterfaceNumber   = RAW_INTERFACE,          // number of this interface: 1
+    .bAlternateSetting  = 0,                      // value used to select alternative setting
+    .bNumEndpoints      = 2,                      // number of endpoints used: 2
+    #ifdef RAW_WINUSB
+    .bInterfaceClass    = USB_DEV_CLASS_VENDOR,   // interface class: vendor (0xFF)
+    #else
+    .bInterfaceClass    = USB_DEV_CLASS_HID,      // interface class: HID (0x03)
+    #endif
+    .bInterfaceSubClass = 0,                      // no boot interface
+    .bInterfaceProtocol = 0,                      // none
+    .iInterface         = 0                       // no interface string descriptor
+  },
+
+  #ifndef RAW_WINUSB
+  // HID Descriptor
+  .hid1 = {
+    .bLength            = sizeof(USB_HID_DESCR),  // size of the descriptor in bytes: 9
+    .bDescriptorType    = USB_DESCR_TYP_HID,      // HID descriptor: 0x21
+    .bcdHID             = 0x0110,                 // HID class spec version (BCD: 1.1)
+    .bCountryCode       = 0,                      // not localized
+    .bNumDescriptors    = 1,                      // number of report descriptors: 1
+    .bDescriptorTypeX   = USB_DESCR_TYP_REPORT,   // descriptor type: report (0x22)
+    .wDescriptorLength  = sizeof(RawReportDescr)  // report descriptor length
+  },
+  #endif
+
+  // Endpoint Descriptor: Endpoint 4 (IN, Interrupt or Bulk)
+  .ep4IN = {
+    .bLength            = sizeof(USB_ENDP_DESCR), // size of the descriptor in bytes: 7
+    .bDescriptorType    = USB_DESCR_TYP_ENDP,     // endpoint descriptor: 0x05
+    .bEndpointAddress   = USB_ENDP_ADDR_EP4_IN,   // endpoint: 4, direction: IN (0x84)
+    #ifdef RAW_WINUSB
+    .bmAttributes       = USB_ENDP_TYPE_BULK,     // transfer type: bulk (0x02)
+    .wMaxPacketSize     = EP4_SIZE,               // max packet size
+    .bInterval          = 0                       // unused for bulk
+    #else
+    .bmAttributes       = USB_ENDP_TYPE_INTER,    // transfer type: interrupt (0x03)
+    .wMaxPacketSize     = EP4_SIZE,               // max packet size
+    .bInterval          = 1                       // polling intervall in ms
+    #endif
+  },
+
+  // Endpoint Descriptor: Endpoint 4 (OUT, Interrupt or Bulk)
+  .ep4OUT = {
+    .bLength            = sizeof(USB_ENDP_DESCR), // size of the descriptor in bytes: 7
+    .bDescriptorType    = USB_DESCR_TYP_ENDP,     // endpoint descriptor: 0x05
+    .bEndpointAddress   = USB_ENDP_ADDR_EP4_OUT,  // endpoint: 4, direction: OUT (0x04)
+    #ifdef RAW_WINUSB
+    .bmAttributes       = USB_ENDP_TYPE_BULK,     // transfer type: bulk (0x02)
+    .wMaxPacketSize     = EP4_SIZE,               // max packet size
+    .bInterval          = 0                       // unused for bulk
+    #else
+    .bmAttributes       = USB_ENDP_TYPE_INTER,    // transfer type: interrupt (0x03)
+    .wMaxPacketSize     = EP4_SIZE,               // max packet size
+    .bInterval          = 1                       // polling intervall in ms
+    #endif
+  },
+  #endif
+};
 
 // ===================================================================================
 // String Descriptors
 // ===================================================================================
 
+// String descriptor header (length and type). SDCC accepts the size of an array in
+// its own initializer, other compilers (host simulation) need a compound literal.
+#ifdef __SDCC
+#define STR_HEADER(name, ...) (((uint16_t)USB_DESCR_TYP_STRING << 8) | sizeof(name))
+#else
+#define STR_HEADER(name, ...) (((uint16_t)USB_DESCR_TYP_STRING << 8) | \
+                               sizeof((uint16_t[]){0, __VA_ARGS__}))
+#endif
+
 // Language Descriptor (Index 0)
 __code uint16_t LangDescr[] = {
-  ((uint16_t)USB_DESCR_TYP_STRING << 8) | sizeof(LangDescr), 0x0409 };  // US English
+  STR_HEADER(LangDescr, 0x0409), 0x0409 };  // US English
 
 // Manufacturer String Descriptor (Index 1)
 __code uint16_t ManufDescr[] = {
-  ((uint16_t)USB_DESCR_TYP_STRING << 8) | sizeof(ManufDescr), MANUFACTURER_STR };
+  STR_HEADER(ManufDescr, MANUFACTURER_STR), MANUFACTURER_STR };
 
 // Product String Descriptor (Index 2)
 __code uint16_t ProdDescr[] = {
-  ((uint16_t)USB_DESCR_TYP_STRING << 8) | sizeof(ProdDescr), PRODUCT_STR };
+  STR_HEADER(ProdDescr, PRODUCT_STR), PRODUCT_STR };
 
 // Serial String Descriptor (Index 3)
 __code uint16_t SerDescr[] = {
-  ((uint16_t)USB_DESCR_TYP_STRING << 8) | sizeof(SerDescr), SERIAL_STR };
+  STR_HEADER(SerDescr, SERIAL_STR), SERIAL_STR };
 
 // Interface String Descriptor (Index 4)
 __code uint16_t InterfDescr[] = {
-  ((uint16_t)USB_DESCR_TYP_STRING << 8) | sizeof(InterfDescr), INTERFACE_STR };
+  STR_HEADER(InterfDescr, INTERFACE_STR), INTERFACE_STR };
+
+#ifdef RAW_WINUSB
+// ===================================================================================
+// Microsoft OS and WebUSB Descriptors
+// ===================================================================================
+// Windows 8.1 and later read the MS OS 2.0 descriptor set announced in the BOS
+// descriptor, older versions the OS string (index 0xEE) and the compatible ID
+// descriptor. Both bind WinUSB to the vendor interface only, the HID interface
+// keeps its class driver. Browsers find the WebUSB capability in the BOS descriptor.
+#define MS_OS_20_SET_LEN    178                 // MS OS 2.0 descriptor set
+#define MS_OS_20_CFG_LEN    168                 // configuration subset
+#define MS_OS_20_FUNC_LEN   160                 // function subset
+#define BOS_LEN             (5 + 24 + 28)       // BOS header and capabilities
+
+#ifdef WEBUSB_URL
+#define WEBUSB_LANDING_PAGE 1                   // URL index of the landing page
+#else
+#define WEBUSB_LANDING_PAGE 0                   // no landing page
+#endif
+
+// OS String Descriptor (Index 0xEE): "MSFT100" and vendor code
+__code uint16_t OSDescr[] = {
+  STR_HEADER(OSDescr, 'M','S','F','T','1','0','0', USB_MS_VENDOR_CODE),
+  'M','S','F','T','1','0','0', USB_MS_VENDOR_CODE };
+
+// BOS Descriptor with WebUSB and MS OS 2.0 platform capabilities
+__code uint8_t BOSDescr[] = {
+  0x05, USB_DESCR_TYP_BOS,          // bLength, bDescriptorType (BOS)
+  BOS_LEN, 0x00,                    // wTotalLength
+  0x02,                             // bNumDeviceCaps
+
+  // WebUSB platform capability
+  0x18, USB_DESCR_TYP_DEV_CAP,      // bLength, bDescriptorType (device capability)
+  0x05, 0x00,                       // bDevCapabilityType (platform), bReserved
+  0x38, 0xb6, 0x08, 0x34, 0xa9, 0x09, 0xa0, 0x47,   // {3408b638-09a9-47a0-
+  0x8b, 0xfd, 0xa0, 0x76, 0x88, 0x15, 0xb6, 0x65,   //  8bfd-a0768815b665}
+  0x00, 0x01,                       // bcdVersion 1.0
+  USB_WEBUSB_VENDOR_CODE,           // bVendorCode
+  WEBUSB_LANDING_PAGE,              // iLandingPage
+
+  // MS OS 2.0 platform capability
+  0x1c, USB_DESCR_TYP_DEV_CAP,      // bLength, bDescriptorType (device capability)
+  0x05, 0x00,                       // bDevCapabilityType (platform), bReserved
+  0xdf, 0x60, 0xdd, 0xd8, 0x89, 0x45, 0xc7, 0x4c,   // {d8dd60df-4589-4cc7-
+  0x9c, 0xd2, 0x65, 0x9d, 0x9e, 0x64, 0x8a, 0x9f,   //  9cd2-659d9e648a9f}
+  0x00, 0x00, 0x03, 0x06,           // dwWindowsVersion (Windows 8.1)
+  MS_OS_20_SET_LEN, 0x00,           // wMSOSDescriptorSetTotalLength
+  USB_MS_VENDOR_CODE,               // bMS_VendorCode
+  0x00                              // bAltEnumCode
+};
+
+// MS OS 2.0 Descriptor Set (vendor request, wIndex 7)
+__code uint8_t MSOS20Descr[] = {
+  0x0a, 0x00, 0x00, 0x00,           // wLength, wDescriptorType (set header)
+  0x00, 0x00, 0x03, 0x06,           // dwWindowsVersion (Windows 8.1)
+  MS_OS_20_SET_LEN, 0x00,           // wTotalLength
+
+  0x08, 0x00, 0x01, 0x00,           // wLength, wDescriptorType (configuration subset)
+  0x00, 0x00,                       // bConfigurationValue (first), bReserved
+  MS_OS_20_CFG_LEN, 0x00,           // wTotalLength
+
+  0x08, 0x00, 0x02, 0x00,           // wLength, wDescriptorType (function subset)
+  RAW_INTERFACE, 0x00,              // bFirstInterface, bReserved
+  MS_OS_20_FUNC_LEN, 0x00,          // wSubsetLength
+
+  0x14, 0x00, 0x03, 0x00,           // wLength, wDescriptorType (compatible ID)
+  'W', 'I', 'N', 'U', 'S', 'B', 0, 0,   // CompatibleID
+  0, 0, 0, 0, 0, 0, 0, 0,           // SubCompatibleID
+
+  0x84, 0x00, 0x04, 0x00,           // wLength, wDescriptorType (registry property)
+  0x07, 0x00,                       // wPropertyDataType (REG_MULTI_SZ)
+  0x2a, 0x00,                       // wPropertyNameLength
+  'D',0, 'e',0, 'v',0, 'i',0, 'c',0, 'e',0, 'I',0, 'n',0, 't',0, 'e',0,
+  'r',0, 'f',0, 'a',0, 'c',0, 'e',0, 'G',0, 'U',0, 'I',0, 'D',0, 's',0,
+  0, 0,
+  0x50, 0x00,                       // wPropertyDataLength
+  '{',0, 'C',0, '6',0, 'C',0, '4',0, 'D',0, '5',0, 'E',0, '2',0, '-',0,
+  '3',0, 'B',0, '1',0, 'F',0, '-',0, '4',0, 'E',0, '8',0, 'A',0, '-',0,
+  '9',0, 'C',0, '6',0, 'D',0, '-',0, '2',0, 'F',0, '5',0, 'B',0, '8',0,
+  'E',0, '1',0, 'A',0, '7',0, 'C',0, '3',0, '0',0, '}',0,
+  0, 0, 0, 0
+};
+
+// MS OS 1.0 Compatible ID Descriptor (vendor request, wIndex 4)
+__code uint8_t MSCompatDescr[] = {
+  0x28, 0x00, 0x00, 0x00,           // dwLength
+  0x00, 0x01, 0x04, 0x00,           // bcdVersion 1.0, wIndex (compatible ID)
+  0x01,                             // bCount: one function
+  0, 0, 0, 0, 0, 0, 0,              // reserved
+  RAW_INTERFACE, 0x01,              // bFirstInterfaceNumber, reserved
+  'W', 'I', 'N', 'U', 'S', 'B', 0, 0,   // compatibleID
+  0, 0, 0, 0, 0, 0, 0, 0,           // subCompatibleID
+  0, 0, 0, 0, 0, 0                  // reserved
+};
+
+#ifdef WEBUSB_URL
+// WebUSB URL Descriptor (vendor request, wIndex 2): landing page
+typedef struct {
+  uint8_t bLength;
+  uint8_t bDescriptorType;
+  uint8_t bScheme;
+  char    URL[sizeof(WEBUSB_URL) - 1];
+} WEBUSB_URL_DESCR;
+
+__code WEBUSB_URL_DESCR URLDescr = {
+  .bLength            = sizeof(WEBUSB_URL_DESCR), // size of the descriptor in bytes
+  .bDescriptorType    = 0x03,                   // WebUSB URL descriptor
+  .bScheme            = 0x01,                   // https://
+  .URL                = WEBUSB_URL              // without terminating zero
+};
+#endif
+
+// Vendor request and wIndex -> descriptor
+__code USB_DESCR_ENTRY VendorTable[] = {
+  {USB_MS_VENDOR_CODE,     7, MSOS20Descr,                  sizeof(MSOS20Descr)},
+  {USB_MS_VENDOR_CODE,     4, MSCompatDescr,                sizeof(MSCompatDescr)},
+  #ifdef WEBUSB_URL
+  {USB_WEBUSB_VENDOR_CODE, 2, (__code uint8_t *)&URLDescr,  sizeof(URLDescr)},
+  #endif
+};
+
+__code uint8_t VendorTableLen = sizeof(VendorTable) / sizeof(USB_DESCR_ENTRY);
+#endif
+
+// ===================================================================================
+// Descriptor Table (GET_DESCRIPTOR type and index -> descriptor)
+// ===================================================================================
+__code USB_DESCR_ENTRY DescrTable[] = {
+  {USB_DESCR_TYP_DEVICE, 0, (__code uint8_t *)&DevDescr,      sizeof(DevDescr)},
+  {USB_DESCR_TYP_CONFIG, 0, (__code uint8_t *)&CfgDescr,      sizeof(CfgDescr)},
+  {USB_DESCR_TYP_REPORT, 0, ReportDescr,                      sizeof(ReportDescr)},
+  {USB_DESCR_TYP_HID,    0, (__code uint8_t *)&CfgDescr.hid0, sizeof(USB_HID_DESCR)},
+  #if defined(RAW_ENABLE) && !defined(RAW_WINUSB)
+  {USB_DESCR_TYP_REPORT, RAW_INTERFACE, RawReportDescr,       sizeof(RawReportDescr)},
+  {USB_DESCR_TYP_HID,    RAW_INTERFACE, (__code uint8_t *)&CfgDescr.hid1, sizeof(USB_HID_DESCR)},
+  #endif
+  {USB_DESCR_TYP_STRING, 0, (__code uint8_t *)LangDescr,      sizeof(LangDescr)},
+  {USB_DESCR_TYP_STRING, 1, (__code uint8_t *)ManufDescr,     sizeof(ManufDescr)},
+  {USB_DESCR_TYP_STRING, 2, (__code uint8_t *)ProdDescr,      sizeof(ProdDescr)},
+  {USB_DESCR_TYP_STRING, 3, (__code uint8_t *)SerDescr,       sizeof(SerDescr)},
+  {USB_DESCR_TYP_STRING, 4, (__code uint8_t *)InterfDescr,    sizeof(InterfDescr)},
+  #ifdef RAW_WINUSB
+  {USB_DESCR_TYP_STRING, 0xEE, (__code uint8_t *)OSDescr,     sizeof(OSDescr)},
+  {USB_DESCR_TYP_BOS,    0, BOSDescr,                         sizeof(BOSDescr)},
+  #endif
+};
+
+__code uint8_t DescrTableLen = sizeof(DescrTable) / sizeof(USB_DESCR_ENTRY);
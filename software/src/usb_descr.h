@@ -19,17 +19,46 @@
 // ===================================================================================
 // USB Endpoint Addresses and Sizes
 // ===================================================================================
-#define EP0_SIZE        8
+// With 64 bytes, the device, configuration and string descriptors are sent in a
+// single packet. The buffers are placed one after the other from address 0, each
+// EP_BUF_SIZE bytes, and must end below TELE_ADDR (see tele.h). EP3 (MIDI) uses
+// both directions: OUT buffer first, IN buffer 64 bytes above. EP4 (raw HID) has
+// no DMA address of its own, its OUT and IN buffers follow EP0 (UEP0_DMA + 64 and
+// + 128).
+#define EP0_SIZE        64
 #define EP1_SIZE        8
 #define EP2_SIZE        8
+#define EP3_SIZE        64
+#define EP4_SIZE        64
+
+#if defined(MIDI_ENABLE) && defined(RAW_ENABLE)
+#error "MIDI_ENABLE and RAW_ENABLE: endpoint buffers do not fit below TELE_ADDR"
+#endif
+#if defined(RAW_WINUSB) && !defined(RAW_ENABLE)
+#error "RAW_WINUSB needs RAW_ENABLE"
+#endif
 
 #define EP0_ADDR        0
-#define EP1_ADDR        (EP0_ADDR + EP0_BUF_SIZE)
+#define EP4_ADDR        (EP0_ADDR + 64)
+#define EP1_ADDR        (EP0_ADDR + EP0_BUF_SIZE + EP4_BUF_SIZE)
 #define EP2_ADDR        (EP1_ADDR + EP1_BUF_SIZE)
+#define EP3_ADDR        (EP2_ADDR + EP2_BUF_SIZE)
 
 #define EP0_BUF_SIZE    EP_BUF_SIZE(EP0_SIZE)
 #define EP1_BUF_SIZE    EP_BUF_SIZE(EP1_SIZE)
 #define EP2_BUF_SIZE    EP_BUF_SIZE(EP2_SIZE)
+#define EP3_BUF_SIZE    (2 * 64)
+#ifdef RAW_ENABLE
+#define EP4_BUF_SIZE    (2 * 64)
+#else
+#define EP4_BUF_SIZE    0
+#endif
+
+#ifdef MIDI_ENABLE
+#define EP_BUF_END      (EP3_ADDR + EP3_BUF_SIZE)
+#else
+#define EP_BUF_END      (EP2_ADDR + EP2_BUF_SIZE)
+#endif
 
 #define EP_BUF_SIZE(x)  (x+2<64 ? x+2 : 64)
 
@@ -42,6 +71,28 @@ typedef struct _USB_CFG_DESCR_HID {
   USB_HID_DESCR hid0;
   USB_ENDP_DESCR ep1IN;
   USB_ENDP_DESCR ep2OUT;
+  #ifdef MIDI_ENABLE
+  USB_ITF_DESCR interface1;                       // audio control
+  USB_AC_HEADER_DESCR acHeader;
+  USB_ITF_DESCR interface2;                       // MIDI streaming
+  USB_MS_HEADER_DESCR msHeader;
+  USB_MIDI_IN_JACK_DESCR jackInEmb;
+  USB_MIDI_IN_JACK_DESCR jackInExt;
+  USB_MIDI_OUT_JACK_DESCR jackOutEmb;
+  USB_MIDI_OUT_JACK_DESCR jackOutExt;
+  USB_AUDIO_ENDP_DESCR ep3OUT;
+  USB_MS_ENDP_DESCR ep3OUTms;
+  USB_AUDIO_ENDP_DESCR ep3IN;
+  USB_MS_ENDP_DESCR ep3INms;
+  #endif
+  #ifdef RAW_ENABLE
+  USB_ITF_DESCR interface1;                       // raw HID or vendor (RAW_WINUSB)
+  #ifndef RAW_WINUSB
+  USB_HID_DESCR hid1;
+  #endif
+  USB_ENDP_DESCR ep4IN;
+  USB_ENDP_DESCR ep4OUT;
+  #endif
 } USB_CFG_DESCR_HID, *PUSB_CFG_DESCR_HID;
 typedef USB_CFG_DESCR_HID __xdata *PXUSB_CFG_DESCR_HID;
 
@@ -52,11 +103,18 @@ extern __code USB_CFG_DESCR_HID CfgDescr;
 // HID Report Descriptors
 // ===================================================================================
 extern __code uint8_t ReportDescr[];
-extern __code uint8_t ReportDescrLen;
+extern __code uint16_t ReportDescrLen;
 
 #define USB_REPORT_DESCR      ReportDescr
 #define USB_REPORT_DESCR_LEN  ReportDescrLen
 
+#ifdef RAW_ENABLE
+#define RAW_INTERFACE         1                   // interface number of raw HID
+#ifndef RAW_WINUSB
+extern __code uint8_t RawReportDescr[];
+#endif
+#endif
+
 // ===================================================================================
 // String Descriptors
 // ===================================================================================
@@ -66,9 +124,41 @@ extern __code uint16_t ProdDescr[];
 extern __code uint16_t SerDescr[];
 extern __code uint16_t InterfDescr[];
 
-#define USB_STR_DESCR_i0    (uint8_t*)LangDescr
-#define USB_STR_DESCR_i1    (uint8_t*)ManufDescr
-#define USB_STR_DESCR_i2    (uint8_t*)ProdDescr
-#define USB_STR_DESCR_i3    (uint8_t*)SerDescr
-#define USB_STR_DESCR_i4    (uint8_t*)InterfDescr
-#define USB_STR_DESCR_ix    (uint8_t*)SerDescr
+#define USB_STR_DESCR_ix    (uint8_t*)SerDescr    // answer to unknown string index
+
+// ===================================================================================
+// Descriptor Table
+// ===================================================================================
+// GET_DESCRIPTOR looks up type and index in this table, which is built by the
+// compiler, and sends the descriptor directly from code memory. HID and report
+// descriptors belong to an interface, their index is the interface number.
+typedef struct {
+  uint8_t  type;                                  // descriptor type (USB_DESCR_TYP_xxx)
+  uint8_t  index;                                 // string index, interface or 0
+  __code uint8_t *descr;                          // descriptor in code memory
+  uint16_t len;                                   // descriptor length in bytes
+} USB_DESCR_ENTRY;
+
+extern __code USB_DESCR_ENTRY DescrTable[];
+extern __code uint8_t DescrTableLen;
+
+#define USB_DESCR_TABLE       DescrTable
+#define USB_DESCR_TABLE_LEN   DescrTableLen
+
+// ===================================================================================
+// Vendor Descriptors (Microsoft OS, WebUSB)
+// ===================================================================================
+// Vendor IN requests are looked up in the second table: type is the request code
+// (announced in the OS string and the BOS descriptor), index is wIndex (MS OS 1.0
+// compatible ID: 4, MS OS 2.0 set: 7, WebUSB GET_URL: 2).
+#ifdef RAW_WINUSB
+#define USB_MS_VENDOR_CODE      0x20              // Microsoft OS descriptor requests
+#define USB_WEBUSB_VENDOR_CODE  0x21              // WebUSB requests
+
+extern __code uint8_t BOSDescr[];
+extern __code USB_DESCR_ENTRY VendorTable[];
+extern __code uint8_t VendorTableLen;
+
+#define USB_VENDOR_TABLE      VendorTable
+#define USB_VENDOR_TABLE_LEN  VendorTableLen
+#endif
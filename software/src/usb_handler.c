@@ -4,22 +4,33 @@
 
 #include "ch554.h"
 #include "usb_handler.h"
+#include "delay.h"
+#include "prof.h"
+#include "tele.h"
 
 uint16_t SetupLen;
 uint8_t  SetupReq, UsbConfig;
 __code uint8_t *pDescr;
+__bit USB_ctrlNS = 0;                             // current request is non-standard
+
+volatile __bit USB_suspendFlag = 0;               // bus suspended by host
+__bit USB_remoteWakeFlag = 0;                     // remote wakeup enabled by host
+volatile __bit USB_wakeSentFlag = 0;              // remote wakeup signaled, no resume yet
 
 // ===================================================================================
 // Fast Copy Function
 // ===================================================================================
 // Copy descriptor *pDescr to Ep0 using double pointer
 // (Thanks to Ralph Doncaster)
+#ifdef __SDCC
 #pragma callee_saves USB_EP0_copyDescr
 void USB_EP0_copyDescr(uint8_t len) {
   len;                          // stop unreferenced argument warning
   __asm
     push ar7                    ; r7 -> stack
     mov  r7, dpl                ; r7 <- len
+    mov  a, r7                  ; len == 0 (zero length packet):
+    jz   02$                    ; nothing to copy, djnz would copy 256 bytes
     inc  _XBUS_AUX              ; select dptr1
     mov  dptr, #_EP0_buffer     ; dptr1 <- EP0_buffer
     dec  _XBUS_AUX              ; select dptr0
@@ -31,98 +42,91 @@ void USB_EP0_copyDescr(uint8_t len) {
     inc  dptr                   ; inc dptr0
     .DB  0xA5                   ; acc -> EP0_buffer[dptr1] & inc dptr1
     djnz r7, 01$                ; repeat len times
+    02$:
     pop  ar7                    ; r7 <- stack
   __endasm;
 }
+#else
+// Portable version for other compilers (host simulation)
+void USB_EP0_copyDescr(uint8_t len) {
+  uint8_t i;
+  for(i=0; i<len; i++) EP0_buffer[i] = pDescr[i];
+}
+#endif
+
+// ===================================================================================
+// Descriptor Lookup
+// ===================================================================================
+// Find type and index in a descriptor table, send the first packet of the
+// descriptor, the following ones are sent by USB_EP0_IN. Returns length or 0xFF.
+uint8_t USB_EP0_descr(__code USB_DESCR_ENTRY *table, uint8_t tableLen,
+                      uint8_t type, uint8_t index) {
+  uint8_t i, len;
+  for(i=0; i<tableLen; i++, table++) {
+    if( (table->type == type) && (table->index == index) ) {
+      pDescr = table->descr;
+      if(SetupLen > table->len) SetupLen = table->len;
+      len = SetupLen >= EP0_SIZE ? EP0_SIZE : SetupLen;   // whole descriptor in one
+      USB_EP0_copyDescr(len);                             // packet if it fits into EP0
+      SetupLen -= len;
+      pDescr += len;
+      return len;
+    }
+  }
+  return 0xFF;                                  // unsupported descriptor
+}
 
 // ===================================================================================
 // Endpoint Handler
 // ===================================================================================
 
 void USB_EP0_SETUP(void) {
-  uint8_t len = USB_RX_LEN;
+  uint8_t index, len = USB_RX_LEN;
+  PROF_start(PROF_EP0_SETUP);
   if(len == (sizeof(USB_SETUP_REQ))) {
     SetupLen = ((uint16_t)USB_setupBuf->wLengthH<<8) | (USB_setupBuf->wLengthL);
     len = 0;                                      // default is success and upload 0 length
     SetupReq = USB_setupBuf->bRequest;
+    USB_ctrlNS = 0;
 
     if( (USB_setupBuf->bRequestType & USB_REQ_TYP_MASK) != USB_REQ_TYP_STANDARD ) {
+      USB_ctrlNS = 1;
+      len = 0xFF;                                 // default: command not supported
+      #ifdef USB_VENDOR_TABLE
+      if( (USB_setupBuf->bRequestType & (USB_REQ_TYP_IN | USB_REQ_TYP_MASK))
+        == (USB_REQ_TYP_IN | USB_REQ_TYP_VENDOR) ) {
+        len = USB_EP0_descr(USB_VENDOR_TABLE, USB_VENDOR_TABLE_LEN, SetupReq,
+                            USB_setupBuf->wIndexL);
+        if(len != 0xFF) {                         // vendor descriptor (MS OS, WebUSB)
+          SetupReq   = USB_GET_DESCRIPTOR;        // rest is sent like a descriptor
+          USB_ctrlNS = 0;
+        }
+      }
+      #endif
       #ifdef USB_CTRL_NS_handler
-      len = USB_CTRL_NS_handler();                // non-standard request
-      #else
-      len = 0xFF;                                 // command not supported
+      if(len == 0xFF) len = USB_CTRL_NS_handler(); // non-standard request
       #endif
     }
 
     else {                                        // standard request
       switch(SetupReq) {                          // request ccfType
         case USB_GET_DESCRIPTOR:
-          switch(USB_setupBuf->wValueH) {
-
-            case USB_DESCR_TYP_DEVICE:            // Device Descriptor
-              pDescr = (uint8_t*)&DevDescr;       // put descriptor into out buffer
-              len = sizeof(DevDescr);             // descriptor length
-              break;
-
-            case USB_DESCR_TYP_CONFIG:            // Configuration Descriptor
-              pDescr = (uint8_t*)&CfgDescr;       // put descriptor into out buffer
-              len = sizeof(CfgDescr);             // descriptor length
-              break;
-
-            case USB_DESCR_TYP_STRING:
-              switch(USB_setupBuf->wValueL) {      // String Descriptor Index
-                case 0:   pDescr = USB_STR_DESCR_i0; break;
-                case 1:   pDescr = USB_STR_DESCR_i1; break;
-                case 2:   pDescr = USB_STR_DESCR_i2; break;
-                case 3:   pDescr = USB_STR_DESCR_i3; break;
-                #ifdef USB_STR_DESCR_i4
-                case 4:   pDescr = USB_STR_DESCR_i4; break;
-                #endif
-                #ifdef USB_STR_DESCR_i5
-                case 5:   pDescr = USB_STR_DESCR_i5; break;
-                #endif
-                #ifdef USB_STR_DESCR_i6
-                case 6:   pDescr = USB_STR_DESCR_i6; break;
-                #endif
-                #ifdef USB_STR_DESCR_i7
-                case 7:   pDescr = USB_STR_DESCR_i7; break;
-                #endif
-                #ifdef USB_STR_DESCR_i8
-                case 8:   pDescr = USB_STR_DESCR_i8; break;
-                #endif
-                #ifdef USB_STR_DESCR_i9
-                case 9:   pDescr = USB_STR_DESCR_i9; break;
-                #endif
-                #ifdef USB_STR_DESCR_ixee
-                case 0xee: pDescr = USB_STR_DESCR_ixee; break;
-                #endif
-                default:  pDescr = USB_STR_DESCR_ix; break;
-              }
-              len = pDescr[0];                    // descriptor length
-              break;
-
-            #ifdef USB_REPORT_DESCR
-            case USB_DESCR_TYP_REPORT:
-              if(USB_setupBuf->wValueL == 0) {
-                pDescr = USB_REPORT_DESCR;
-                len = USB_REPORT_DESCR_LEN;
-              }
-              else len = 0xff;
-              break;
-            #endif
-
-            default:
-              len = 0xff;                         // unsupported descriptors or error
-              break;
-          }
-
-          if(len != 0xff) {
-            if(SetupLen > len) SetupLen = len;    // limit length
+          index = USB_setupBuf->wValueL;          // string index
+          if( (USB_setupBuf->wValueH == USB_DESCR_TYP_HID)
+           || (USB_setupBuf->wValueH == USB_DESCR_TYP_REPORT) )
+            index = USB_setupBuf->wIndexL;        // interface number
+          len = USB_EP0_descr(USB_DESCR_TABLE, USB_DESCR_TABLE_LEN,
+                              USB_setupBuf->wValueH, index);
+          #ifdef USB_STR_DESCR_ix
+          if( (len == 0xff) && (USB_setupBuf->wValueH == USB_DESCR_TYP_STRING) ) {
+            pDescr = USB_STR_DESCR_ix;            // unknown string index
+            if(SetupLen > pDescr[0]) SetupLen = pDescr[0];
             len = SetupLen >= EP0_SIZE ? EP0_SIZE : SetupLen;
             USB_EP0_copyDescr(len);               // copy descriptor to Ep0
             SetupLen -= len;
             pDescr += len;
           }
+          #endif
           break;
 
         case USB_SET_ADDRESS:
@@ -148,7 +152,7 @@ void USB_EP0_SETUP(void) {
           if( (USB_setupBuf->bRequestType & 0x1F) == USB_REQ_RECIP_DEVICE ) {
             if( ( ( (uint16_t)USB_setupBuf->wValueH << 8 ) | USB_setupBuf->wValueL ) == 0x01 ) {
               if( ((uint8_t*)&CfgDescr)[7] & 0x20) {
-                // wake up
+                USB_remoteWakeFlag = 0;      // disable remote wakeup
               }
               else len = 0xFF;               // failed
             }
@@ -158,42 +162,42 @@ void USB_EP0_SETUP(void) {
             switch(USB_setupBuf->wIndexL) {
               #ifdef EP4_IN_callback
               case 0x84:
-                UEP4_CTRL = UEP4_CTRL & ~ ( bUEP_T_TOG | MASK_UEP_T_RES ) | UEP_T_RES_NAK;
+                UEP4_CTRL = (UEP4_CTRL & ~ ( bUEP_T_TOG | MASK_UEP_T_RES )) | UEP_T_RES_NAK;
                 break;
               #endif
               #ifdef EP4_OUT_callback
               case 0x04:
-                UEP4_CTRL = UEP4_CTRL & ~ ( bUEP_R_TOG | MASK_UEP_R_RES ) | UEP_R_RES_ACK;
+                UEP4_CTRL = (UEP4_CTRL & ~ ( bUEP_R_TOG | MASK_UEP_R_RES )) | UEP_R_RES_ACK;
                 break;
               #endif
               #ifdef EP3_IN_callback
               case 0x83:
-                UEP3_CTRL = UEP3_CTRL & ~ ( bUEP_T_TOG | MASK_UEP_T_RES ) | UEP_T_RES_NAK;
+                UEP3_CTRL = (UEP3_CTRL & ~ ( bUEP_T_TOG | MASK_UEP_T_RES )) | UEP_T_RES_NAK;
                 break;
               #endif
               #ifdef EP3_OUT_callback
               case 0x03:
-                UEP3_CTRL = UEP3_CTRL & ~ ( bUEP_R_TOG | MASK_UEP_R_RES ) | UEP_R_RES_ACK;
+                UEP3_CTRL = (UEP3_CTRL & ~ ( bUEP_R_TOG | MASK_UEP_R_RES )) | UEP_R_RES_ACK;
                 break;
               #endif
               #ifdef EP2_IN_callback
               case 0x82:
-                UEP2_CTRL = UEP2_CTRL & ~ ( bUEP_T_TOG | MASK_UEP_T_RES ) | UEP_T_RES_NAK;
+                UEP2_CTRL = (UEP2_CTRL & ~ ( bUEP_T_TOG | MASK_UEP_T_RES )) | UEP_T_RES_NAK;
                 break;
               #endif
               #ifdef EP2_OUT_callback
               case 0x02:
-                UEP2_CTRL = UEP2_CTRL & ~ ( bUEP_R_TOG | MASK_UEP_R_RES ) | UEP_R_RES_ACK;
+                UEP2_CTRL = (UEP2_CTRL & ~ ( bUEP_R_TOG | MASK_UEP_R_RES )) | UEP_R_RES_ACK;
                 break;
               #endif
               #ifdef EP1_IN_callback
               case 0x81:
-                UEP1_CTRL = UEP1_CTRL & ~ ( bUEP_T_TOG | MASK_UEP_T_RES ) | UEP_T_RES_NAK;
+                UEP1_CTRL = (UEP1_CTRL & ~ ( bUEP_T_TOG | MASK_UEP_T_RES )) | UEP_T_RES_NAK;
                 break;
               #endif
               #ifdef EP1_OUT_callback
               case 0x01:
-                UEP1_CTRL = UEP1_CTRL & ~ ( bUEP_R_TOG | MASK_UEP_R_RES ) | UEP_R_RES_ACK;
+                UEP1_CTRL = (UEP1_CTRL & ~ ( bUEP_R_TOG | MASK_UEP_R_RES )) | UEP_R_RES_ACK;
                 break;
               #endif
               default:
@@ -207,7 +211,10 @@ void USB_EP0_SETUP(void) {
         case USB_SET_FEATURE:
           if( (USB_setupBuf->bRequestType & 0x1F) == USB_REQ_RECIP_DEVICE ) {
             if( ( ( (uint16_t)USB_setupBuf->wValueH << 8 ) | USB_setupBuf->wValueL ) == 0x01 ) {
-              if( !(((uint8_t*)&CfgDescr)[7] & 0x20) ) len = 0xFF;  // failed
+              if( ((uint8_t*)&CfgDescr)[7] & 0x20 ) {
+                USB_remoteWakeFlag = 1;                             // enable remote wakeup
+              }
+              else len = 0xFF;                                      // failed
             }
             else len = 0xFF;                                        // failed
           }
@@ -216,42 +223,42 @@ void USB_EP0_SETUP(void) {
               switch( ( (uint16_t)USB_setupBuf->wIndexH << 8 ) | USB_setupBuf->wIndexL ) {
                 #ifdef EP4_IN_callback
                 case 0x84:
-                  UEP4_CTRL = UEP4_CTRL & (~bUEP_T_TOG) | UEP_T_RES_STALL;// Set EP4 IN STALL 
+                  UEP4_CTRL = (UEP4_CTRL & (~bUEP_T_TOG)) | UEP_T_RES_STALL;// Set EP4 IN STALL 
                   break;
                 #endif
                 #ifdef EP4_OUT_callback
                 case 0x04:
-                  UEP4_CTRL = UEP4_CTRL & (~bUEP_R_TOG) | UEP_R_RES_STALL;// Set EP4 OUT Stall 
+                  UEP4_CTRL = (UEP4_CTRL & (~bUEP_R_TOG)) | UEP_R_RES_STALL;// Set EP4 OUT Stall 
                   break;
                 #endif
                 #ifdef EP3_IN_callback
                 case 0x83:
-                  UEP3_CTRL = UEP3_CTRL & (~bUEP_T_TOG) | UEP_T_RES_STALL;// Set EP3 IN STALL 
+                  UEP3_CTRL = (UEP3_CTRL & (~bUEP_T_TOG)) | UEP_T_RES_STALL;// Set EP3 IN STALL 
                   break;
                 #endif
                 #ifdef EP3_OUT_callback
                 case 0x03:
-                  UEP3_CTRL = UEP3_CTRL & (~bUEP_R_TOG) | UEP_R_RES_STALL;// Set EP3 OUT Stall 
+                  UEP3_CTRL = (UEP3_CTRL & (~bUEP_R_TOG)) | UEP_R_RES_STALL;// Set EP3 OUT Stall 
                   break;
                 #endif
                 #ifdef EP2_IN_callback
                 case 0x82:
-                  UEP2_CTRL = UEP2_CTRL & (~bUEP_T_TOG) | UEP_T_RES_STALL;// Set EP2 IN STALL 
+                  UEP2_CTRL = (UEP2_CTRL & (~bUEP_T_TOG)) | UEP_T_RES_STALL;// Set EP2 IN STALL 
                   break;
                 #endif
                 #ifdef EP2_OUT_callback
                 case 0x02:
-                  UEP2_CTRL = UEP2_CTRL & (~bUEP_R_TOG) | UEP_R_RES_STALL;// Set EP2 OUT Stall 
+                  UEP2_CTRL = (UEP2_CTRL & (~bUEP_R_TOG)) | UEP_R_RES_STALL;// Set EP2 OUT Stall 
                   break;
                 #endif
                 #ifdef EP1_IN_callback
                 case 0x81:
-                  UEP1_CTRL = UEP1_CTRL & (~bUEP_T_TOG) | UEP_T_RES_STALL;// Set EP1 IN STALL 
+                  UEP1_CTRL = (UEP1_CTRL & (~bUEP_T_TOG)) | UEP_T_RES_STALL;// Set EP1 IN STALL 
                   break;
                 #endif
                 #ifdef EP1_OUT_callback
                 case 0x01:
-                  UEP1_CTRL = UEP1_CTRL & (~bUEP_R_TOG) | UEP_R_RES_STALL;// Set EP1 OUT Stall
+                  UEP1_CTRL = (UEP1_CTRL & (~bUEP_R_TOG)) | UEP_R_RES_STALL;// Set EP1 OUT Stall
                   break;
                 #endif
                 default:
@@ -266,6 +273,8 @@ void USB_EP0_SETUP(void) {
 
         case USB_GET_STATUS:
           EP0_buffer[0] = 0x00;
+          if( ((USB_setupBuf->bRequestType & USB_REQ_RECIP_MASK) == USB_REQ_RECIP_DEVICE)
+            && USB_remoteWakeFlag ) EP0_buffer[0] = 0x02;   // remote wakeup enabled
           EP0_buffer[1] = 0x00;
           if(SetupLen >= 2) len = 2;
           else len = SetupLen;
@@ -281,6 +290,7 @@ void USB_EP0_SETUP(void) {
 
   if(len == 0xff) {
     SetupReq = 0xFF;
+    TELE_count(stalls);                     // transport telemetry
     UEP0_CTRL = bUEP_R_TOG | bUEP_T_TOG | UEP_R_RES_STALL | UEP_T_RES_STALL;//STALL
   }
   else if(len <= EP0_SIZE) {      // Tx data to host or send 0-length packet
@@ -291,10 +301,12 @@ void USB_EP0_SETUP(void) {
     UEP0_T_LEN = 0;  // Tx data to host or send 0-length packet
     UEP0_CTRL = bUEP_R_TOG | bUEP_T_TOG | UEP_R_RES_ACK | UEP_T_RES_ACK;// Expect DATA1, Answer ACK
   }
+  PROF_stop(PROF_EP0_SETUP);
 }
 
 void USB_EP0_IN(void) {
   uint8_t len;
+  PROF_start(PROF_EP0_IN);
   switch(SetupReq) {
 
     case USB_GET_DESCRIPTOR:
@@ -307,18 +319,37 @@ void USB_EP0_IN(void) {
       break;
 
     case USB_SET_ADDRESS:
-      USB_DEV_AD = USB_DEV_AD & bUDA_GP_BIT | SetupLen;
+      USB_DEV_AD = (USB_DEV_AD & bUDA_GP_BIT) | SetupLen;
       UEP0_CTRL  = UEP_R_RES_ACK | UEP_T_RES_NAK;
       break;
 
     default:
+      #ifdef USB_CTRL_NS_IN_handler
+      if(USB_ctrlNS) {                            // non-standard request with data?
+        len = USB_CTRL_NS_IN_handler();           // next packet or 0xFF if done
+        if(len != 0xFF) {
+          UEP0_T_LEN = len;
+          UEP0_CTRL ^= bUEP_T_TOG;                // switch between DATA0 and DATA1
+          break;
+        }
+      }
+      #endif
       UEP0_T_LEN = 0;                             // end of transaction
       UEP0_CTRL  = UEP_R_RES_ACK | UEP_T_RES_NAK;
       break;
   }
+  PROF_stop(PROF_EP0_IN);
 }
 
 void USB_EP0_OUT(void) {
+  #ifdef USB_CTRL_NS_OUT_handler
+  if(USB_ctrlNS) {                                // non-standard request with data?
+    if(USB_CTRL_NS_OUT_handler() != 0xFF) {       // data packet taken by handler?
+      UEP0_CTRL ^= bUEP_R_TOG;                    // switch between DATA0 and DATA1
+      return;                                     // status stage follows (IN, ACK)
+    }
+  }
+  #endif
   UEP0_T_LEN = 0;
   UEP0_CTRL |= UEP_R_RES_ACK | UEP_T_RES_NAK;     // respond Nak
 }
@@ -330,6 +361,7 @@ void USB_EP0_OUT(void) {
 #pragma save
 #pragma nooverlay
 void USB_interrupt(void) {   // inline not really working in multiple files in SDCC
+  PROF_start(PROF_USB_ISR);
   if(UIF_TRANSFER) {
     // Dispatch to service functions
     uint8_t callIndex = USB_INT_ST & MASK_UIS_ENDP;
@@ -415,12 +447,16 @@ void USB_interrupt(void) {   // inline not really working in multiple files in S
   // Device mode USB bus reset
   if(UIF_BUS_RST) {
     UEP0_CTRL = UEP_R_RES_ACK | UEP_T_RES_NAK;
+    TELE_count(busResets);                  // transport telemetry
 
     #ifdef USB_RESET_handler
     USB_RESET_handler();                    // custom reset handler
     #endif
 
     USB_DEV_AD   = 0x00;
+    USB_suspendFlag    = 0;                 // bus is active again
+    USB_remoteWakeFlag = 0;                 // host has to enable it again
+    USB_wakeSentFlag   = 0;
     UIF_SUSPEND  = 0;
     UIF_TRANSFER = 0;
     UIF_BUS_RST  = 0;                       // clear interrupt flag
@@ -429,11 +465,35 @@ void USB_interrupt(void) {   // inline not really working in multiple files in S
   // USB bus suspend / wake up
   if (UIF_SUSPEND) {
     UIF_SUSPEND = 0;
-    if ( !(USB_MIS_ST & bUMS_SUSPEND) ) USB_INT_FG = 0xFF;  // clear interrupt flag
+    if (USB_MIS_ST & bUMS_SUSPEND) {                        // bus went idle: suspend
+      USB_suspendFlag  = 1;
+      USB_wakeSentFlag = 0;                                 // new suspend: may wake once
+      TELE_count(suspends);                                 // transport telemetry
+    }
+    else {                                                  // bus activity: resume
+      USB_suspendFlag  = 0;
+      USB_wakeSentFlag = 0;                                 // host has resumed
+      USB_INT_FG = 0xFF;                                    // clear interrupt flag
+    }
   }
+  PROF_stop(PROF_USB_ISR);
 }
 #pragma restore
 
+// ===================================================================================
+// USB Remote Wakeup
+// ===================================================================================
+
+// Signal resume (K-state for 2ms) to wake up the suspended host, only once until
+// the host resumes the bus (or the caller gives up and clears USB_wakeSentFlag)
+void USB_wakeHost(void) {
+  if(USB_wakeSentFlag) return;              // already signaled in this suspend
+  USB_wakeSentFlag = 1;
+  UDEV_CTRL |= bUD_LOW_SPEED;               // drive K-state on the bus
+  DLY_ms(2);                                // resume signaling (1..15ms)
+  UDEV_CTRL &= ~bUD_LOW_SPEED;              // release bus
+}
+
 // ===================================================================================
 // USB Init Function
 // ===================================================================================
@@ -462,6 +522,10 @@ void USB_init(void) {
               | bUIE_TRANSFER               // Enable USB transfer completion interrupt
               | bUIE_BUS_RST;               // Enable device mode USB bus reset interrupt
 
+  #ifdef EP0_SOF_callback
+  USB_INT_EN |= bUIE_DEV_SOF;               // Enable SOF interrupt
+  #endif
+
   USB_INT_FG |= 0x1F;                       // Clear interrupt flag
   IE_USB      = 1;                          // Enable USB interrupt
   EA          = 1;                          // Enable global interrupts
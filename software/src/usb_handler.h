@@ -12,10 +12,23 @@
 __xdata __at (EP0_ADDR) uint8_t EP0_buffer[EP0_BUF_SIZE];     
 __xdata __at (EP1_ADDR) uint8_t EP1_buffer[EP1_BUF_SIZE];
 __xdata __at (EP2_ADDR) uint8_t EP2_buffer[EP2_BUF_SIZE];
+#ifdef MIDI_ENABLE
+__xdata __at (EP3_ADDR) uint8_t EP3_buffer[EP3_BUF_SIZE];
+#endif
+#ifdef RAW_ENABLE
+__xdata __at (EP4_ADDR) uint8_t EP4_buffer[EP4_BUF_SIZE];
+#endif
 
 #define USB_setupBuf ((PUSB_SETUP_REQ)EP0_buffer)
 extern uint8_t SetupReq;
 
+// ===================================================================================
+// USB Bus State
+// ===================================================================================
+extern volatile __bit USB_suspendFlag;        // bus suspended by host
+extern __bit USB_remoteWakeFlag;              // remote wakeup enabled by host
+extern volatile __bit USB_wakeSentFlag;       // remote wakeup signaled, no resume yet
+
 // ===================================================================================
 // Custom External USB Handler Functions
 // ===================================================================================
@@ -23,6 +36,16 @@ void HID_setup(void);
 void HID_reset(void);
 void HID_EP1_IN(void);
 void HID_EP2_OUT(void);
+uint8_t HID_control(void);
+uint8_t HID_controlIn(void);
+uint8_t HID_controlOut(void);
+uint8_t HID_getFeature(uint8_t id);
+void HID_setFeature(uint8_t id, uint8_t len);
+void TICK_SOF(void);
+void MIDI_EP3_IN(void);
+void MIDI_EP3_OUT(void);
+void RAW_EP4_IN(void);
+void RAW_EP4_OUT(void);
 
 // ===================================================================================
 // USB Handler Defines
@@ -30,16 +53,36 @@ void HID_EP2_OUT(void);
 // Custom USB handler functions
 #define USB_INIT_handler    HID_setup         // init custom endpoints
 #define USB_RESET_handler   HID_reset         // custom USB reset handler
+#define USB_CTRL_NS_handler HID_control       // HID class requests
+#define USB_CTRL_NS_IN_handler HID_controlIn  // further data packets
+#define USB_CTRL_NS_OUT_handler HID_controlOut  // data packets from host
+
+// HID feature report handler: fills HID_featureBuf (or points HID_featurePtr to
+// the report), returns length or 0xFF
+#define HID_GET_FEATURE_handler HID_getFeature
+
+// HID feature report handler for reports from host (report in HID_featureBuf)
+#define HID_SET_FEATURE_handler HID_setFeature
 
 // Endpoint callback functions
 #define EP0_SETUP_callback  USB_EP0_SETUP
 #define EP0_IN_callback     USB_EP0_IN
 #define EP0_OUT_callback    USB_EP0_OUT
+#define EP0_SOF_callback    TICK_SOF          // 1ms timebase from SOF
 #define EP1_IN_callback     HID_EP1_IN
 #define EP2_OUT_callback    HID_EP2_OUT
+#ifdef MIDI_ENABLE
+#define EP3_IN_callback     MIDI_EP3_IN       // MIDI events sent to host
+#define EP3_OUT_callback    MIDI_EP3_OUT      // MIDI events from host
+#endif
+#ifdef RAW_ENABLE
+#define EP4_IN_callback     RAW_EP4_IN        // raw HID packet sent to host
+#define EP4_OUT_callback    RAW_EP4_OUT       // raw HID packet from host
+#endif
 
 // ===================================================================================
 // Functions
 // ===================================================================================
 void USB_interrupt(void);
 void USB_init(void);
+void USB_wakeHost(void);                      // signal remote wakeup to host
@@ -5,7 +5,16 @@
 #include "ch554.h"
 #include "usb.h"
 #include "usb_hid.h"
+#include "usb_composite.h"
 #include "usb_descr.h"
+#include "system.h"
+#include "lat.h"
+#include "tick.h"
+#include "prof.h"
+#include "trace.h"
+#include "tele.h"
+#include "midi.h"
+#include "raw.h"
 
 // ===================================================================================
 // Variables and Defines
@@ -13,6 +22,22 @@
 
 volatile __bit HID_EP1_writeBusyFlag = 0;                   // upload pointer busy flag
 
+#define HID_QUEUE_MASK    (HID_QUEUE_SIZE - 1)
+__xdata uint8_t HID_queue[HID_QUEUE_SIZE];                  // queued reports: length, data
+uint8_t HID_queueHead = 0;                                  // oldest report in queue
+uint8_t HID_queueLen  = 0;                                  // bytes in queue
+volatile __bit HID_queueResetFlag = 0;                      // bus reset: empty the queue
+__bit HID_queueStuck = 0;                                   // host stopped fetching reports
+
+__xdata uint8_t HID_featureBuf[HID_FEATURE_SIZE];           // feature report to send
+__xdata uint8_t *HID_featurePtr;                            // next byte to send
+uint8_t HID_featureLen;                                     // bytes left to send
+__bit HID_featureActive = 0;                                // feature report transfer
+#ifdef HID_SET_FEATURE_handler
+uint8_t HID_featureId;                                      // ID of received report
+__bit HID_featureOut = 0;                                   // feature report reception
+#endif
+
 // ===================================================================================
 // Front End Functions
 // ===================================================================================
@@ -23,14 +48,79 @@ void HID_init(void) {
   UEP1_T_LEN  = 0;
 }
 
-// Send HID report
-void HID_sendReport(__xdata uint8_t* buf, uint8_t len) {
-  uint8_t i;
-  while(HID_EP1_writeBusyFlag);                             // wait for ready to write
-  for(i=0; i<len; i++) EP1_buffer[i] = buf[i];              // copy report to EP1 buffer
+// Upload report in EP1 buffer
+void HID_upload(uint8_t len) {
   UEP1_T_LEN = len;                                         // set length to upload
   HID_EP1_writeBusyFlag = 1;                                // set busy flag
-  UEP1_CTRL = UEP1_CTRL & ~MASK_UEP_T_RES | UEP_T_RES_ACK;  // upload data and respond ACK
+  LAT_queued();                                             // latency measurement
+  TRACE_report(EP1_buffer, len);                            // input event trace
+  UEP1_CTRL = (UEP1_CTRL & ~MASK_UEP_T_RES) | UEP_T_RES_ACK;  // upload data and respond ACK
+}
+
+// Empty the queue after a bus reset. HID_reset() runs in the USB interrupt and only
+// sets the flag, head and length are changed by the main loop alone.
+void HID_queueCheck(void) {
+  if(!HID_queueResetFlag) return;
+  HID_queueResetFlag = 0;
+  HID_queueStuck = 0;
+  HID_queueHead = 0;
+  HID_queueLen  = 0;                                        // reports of the old session
+}
+
+// Send HID report, queue it if EP1 is busy. If the queue stays full for
+// HID_QUEUE_WAIT ms or the host sleeps, the report is dropped. Until the host
+// fetches a report again, further reports find the queue stuck and are dropped
+// without waiting.
+void HID_sendReport(__xdata uint8_t* buf, uint8_t len) {
+  uint8_t i, pos;
+  uint16_t start;
+  if(USB_suspendFlag) {                                     // host is sleeping?
+    if(!USB_remoteWakeFlag) {                               // not allowed to wake it up
+      TELE_count(dropped);                                  // report is lost
+      return;
+    }
+    USB_wakeHost();                                         // wake up host
+  }
+  PROF_start(PROF_REPORT);
+  HID_queueCheck();
+  if(!HID_busy()) {                                         // EP1 free, nothing queued?
+    for(i=0; i<len; i++) EP1_buffer[i] = buf[i];            // copy report to EP1 buffer
+    HID_upload(len);
+    PROF_stop(PROF_REPORT);
+    return;
+  }
+  start = TICK_millis();
+  while(HID_queueLen + len >= HID_QUEUE_SIZE) {             // queue full: wait for room
+    if((uint16_t)(TICK_millis() - start) >= HID_QUEUE_WAIT)
+      HID_queueStuck = 1;                                   // host stopped fetching reports
+    if(HID_queueStuck || (USB_suspendFlag && !USB_wakeSentFlag)) { // or sleeps (no resume due)
+      TELE_count(dropped);                                  // report is lost
+      PROF_stop(PROF_REPORT);
+      return;
+    }
+    TELE_data.spins++;                                      // transport telemetry
+    WDT_reset();
+    HID_step();
+    WAIT_hook();
+  }
+  pos = HID_queueHead + HID_queueLen;
+  HID_queue[pos++ & HID_QUEUE_MASK] = len;                  // queue length and report
+  for(i=0; i<len; i++) HID_queue[pos++ & HID_QUEUE_MASK] = buf[i];
+  HID_queueLen += len + 1;
+  PROF_stop(PROF_REPORT);
+}
+
+// Send next queued report if EP1 is free (macro step task, call every tick)
+void HID_step(void) {
+  uint8_t i, len;
+  HID_queueCheck();
+  if(!HID_queueLen || HID_EP1_writeBusyFlag) return;        // nothing queued or EP1 busy
+  len = HID_queue[HID_queueHead++ & HID_QUEUE_MASK];
+  for(i=0; i<len; i++) EP1_buffer[i] = HID_queue[HID_queueHead++ & HID_QUEUE_MASK];
+  HID_queueHead &= HID_QUEUE_MASK;
+  HID_queueLen -= len + 1;
+  HID_queueStuck = 0;                                       // host fetches reports again
+  HID_upload(len);
 }
 
 // ===================================================================================
@@ -47,6 +137,12 @@ void HID_setup(void) {
               | UEP_R_RES_ACK;              // EP2 OUT transaction returns ACK
   UEP4_1_MOD  = bUEP1_TX_EN;                // EP1 TX enable
   UEP2_3_MOD  = bUEP2_RX_EN;                // EP2 RX enable
+  #ifdef MIDI_ENABLE
+  MIDI_setup();                             // EP3 for the MIDI interface
+  #endif
+  #ifdef RAW_ENABLE
+  RAW_setup();                              // EP4 for the raw HID interface
+  #endif
 }
 
 // Reset HID parameters
@@ -54,15 +150,97 @@ void HID_reset(void) {
   UEP1_CTRL = bUEP_AUTO_TOG | UEP_T_RES_NAK;
   UEP2_CTRL = bUEP_AUTO_TOG | UEP_R_RES_ACK;
   HID_EP1_writeBusyFlag = 0;
+  HID_queueResetFlag = 1;                   // reports of the old session are stale
+  MOUSE_resMult = 0;                        // multiplier defaults to 1 after reset
+  #ifdef MIDI_ENABLE
+  MIDI_reset();
+  #endif
+  #ifdef RAW_ENABLE
+  RAW_reset();
+  #endif
+}
+
+// HID class requests (non-standard control requests)
+uint8_t HID_control(void) {
+  uint8_t len = 0xFF;                                       // default: not supported
+  if( (USB_setupBuf->bRequestType & USB_REQ_TYP_MASK) == USB_REQ_TYP_CLASS ) {
+    switch(SetupReq) {
+      #ifdef HID_GET_FEATURE_handler
+      case HID_GET_REPORT:
+        HID_featureActive = 0;
+        if(USB_setupBuf->wValueH == 3) {                    // feature report?
+          HID_featurePtr = HID_featureBuf;                  // handler may redirect it
+          len = HID_GET_FEATURE_handler(USB_setupBuf->wValueL);
+          if(len != 0xFF) {
+            if( (len > USB_setupBuf->wLengthL) && !USB_setupBuf->wLengthH )
+              len = USB_setupBuf->wLengthL;                 // limit to requested length
+            HID_featureLen    = len;                        // send in EP0 packets
+            HID_featureActive = 1;
+            len = HID_controlIn();                          // first packet
+          }
+        }
+        break;
+      #endif
+      #ifdef HID_SET_FEATURE_handler
+      case HID_SET_REPORT:
+        HID_featureOut = 0;
+        if( (USB_setupBuf->wValueH == 3) && !USB_setupBuf->wLengthH
+          && (USB_setupBuf->wLengthL <= HID_FEATURE_SIZE) ) { // feature report?
+          HID_featureId  = USB_setupBuf->wValueL;
+          HID_featurePtr = HID_featureBuf;                  // receive in EP0 packets
+          HID_featureLen = USB_setupBuf->wLengthL;
+          HID_featureOut = 1;
+          len = 0;                                          // wait for data stage
+        }
+        break;
+      #endif
+      default:
+        break;
+    }
+  }
+  return len;
+}
+
+// Next packet of a feature report, returns length or 0xFF if transfer is done
+uint8_t HID_controlIn(void) {
+  uint8_t i, len;
+  if(!HID_featureActive) return 0xFF;
+  len = HID_featureLen >= EP0_SIZE ? EP0_SIZE : HID_featureLen;
+  for(i=0; i<len; i++) EP0_buffer[i] = *HID_featurePtr++;
+  HID_featureLen -= len;
+  if(len < EP0_SIZE) HID_featureActive = 0;                 // short packet ends transfer
+  return len;
+}
+
+// Data packet of a feature report from host, returns 0xFF if not expected
+#ifdef HID_SET_FEATURE_handler
+uint8_t HID_controlOut(void) {
+  uint8_t i, len;
+  if(!HID_featureOut) return 0xFF;
+  len = USB_RX_LEN;
+  if(len > HID_featureLen) len = HID_featureLen;
+  for(i=0; i<len; i++) *HID_featurePtr++ = EP0_buffer[i];
+  HID_featureLen -= len;
+  if(!HID_featureLen || (len < EP0_SIZE)) {                 // last packet?
+    HID_featureOut = 0;
+    HID_SET_FEATURE_handler(HID_featureId, HID_featurePtr - HID_featureBuf);
+  }
+  return len;
 }
+#endif
 
 // Endpoint 1 IN handler (HID report transfer to host)
 void HID_EP1_IN(void) {
+  PROF_start(PROF_EP1_IN);
+  LAT_acked();                                              // latency measurement
   UEP1_T_LEN = 0;                                           // no data to send anymore
-  UEP1_CTRL = UEP1_CTRL & ~MASK_UEP_T_RES | UEP_T_RES_NAK;  // default NAK
+  UEP1_CTRL = (UEP1_CTRL & ~MASK_UEP_T_RES) | UEP_T_RES_NAK;  // default NAK
   HID_EP1_writeBusyFlag = 0;                                // clear busy flag
+  PROF_stop(PROF_EP1_IN);
 }
 
 // Endpoint 2 OUT handler (HID report transfer from host)
 void HID_EP2_OUT(void) {                                    // auto response
+  PROF_start(PROF_EP2_OUT);
+  PROF_stop(PROF_EP2_OUT);
 }
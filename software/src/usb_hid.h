@@ -5,6 +5,24 @@
 #pragma once
 #include <stdint.h>
 #include "usb_handler.h"
+#include "config.h"
+
+#ifdef TRACE_ENABLE
+#define HID_FEATURE_SIZE  72                              // max feature report length
+#else                                                     // (trace chunk: 69 bytes)
+#define HID_FEATURE_SIZE  40
+#endif
+
+extern __xdata uint8_t HID_featureBuf[HID_FEATURE_SIZE];  // filled by feature handler
+extern __xdata uint8_t *HID_featurePtr;                   // data to send (HID_featureBuf)
+extern volatile __bit HID_EP1_writeBusyFlag;              // report not fetched by host
+extern uint8_t HID_queueLen;                              // bytes in report queue
+
+// Reports are sent at once if EP1 is free, otherwise they wait in a queue which
+// HID_step() sends one report per tick (macro step task). HID_sendReport() only
+// blocks when the queue is full, and drops the report after HID_QUEUE_WAIT ms.
+#define HID_busy()        (HID_EP1_writeBusyFlag || HID_queueLen) // new report has to wait
 
 void HID_init(void);                                      // setup USB-HID
-void HID_sendReport(__xdata uint8_t* buf, uint8_t len);   // send HID report
+void HID_sendReport(__xdata uint8_t* buf, uint8_t len);   // send or queue HID report
+void HID_step(void);                                      // send next queued report
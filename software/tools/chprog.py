@@ -23,6 +23,7 @@
 # Dependencies:
 # -------------
 # - pyusb
+# - hidapi (python bindings), only for option -r
 #
 # Operating Instructions:
 # -----------------------
@@ -39,11 +40,35 @@
 #
 # Connect the CH55x via USB to your PC. The CH55x must be in bootloader mode!
 # Run "python3 chprog.py firmware.bin".
+#
+# To provision many devices at once, "-a" flashes and verifies all connected
+# bootloaders in parallel (one thread per device) and prints a summary. "-w" keeps
+# watching the bus and flashes every bootloader as soon as it is attached, CTRL-C
+# stops and prints the summary. Together with "-r" all connected MacroPads are put
+# into bootloader mode first.
+#
+# With "-d" the firmware is compared with the flash content first (verify command
+# of the bootloader) and only written if it differs. The bootloader can only erase
+# the whole code flash, so a changed firmware is still written completely, but an
+# unchanged one (e.g. "make flash" after a build without changes) is not erased and
+# rewritten again. "make flash" uses "-d".
+#
+# "--fake FLASH.bin" runs everything against a simulated bootloader instead of the
+# device, the simulated flash content is loaded from and saved to FLASH.bin. This
+# tests the protocol path of chprog without hardware.
+#
+# A running MacroPad Plus firmware does not have to be put into bootloader mode by
+# hand: "python3 chprog.py -r firmware.bin" sends the bootloader request (feature
+# report 0x15 on the diagnostics interface), waits for the bootloader to show up
+# and flashes the firmware.
 
 
-import usb.core
-import usb.util
-import sys, struct
+try:
+    import usb.core
+    import usb.util
+except ImportError:
+    usb = None                                  # not needed with --fake
+import sys, os, struct, time, platform, argparse, threading
 
 
 # ===================================================================================
@@ -51,25 +76,33 @@ import sys, struct
 # ===================================================================================
 
 def _main():
-    if len(sys.argv) != 2:
-        sys.stderr.write('ERROR: No bin file selected!\n')
-        sys.exit(1)
+    parser = argparse.ArgumentParser(description = 'Programming tool for CH55x microcontrollers')
+    parser.add_argument('-r', action = 'store_true', help = 'request bootloader from running MacroPads first')
+    parser.add_argument('-d', action = 'store_true', help = 'only write if the flash content differs')
+    parser.add_argument('-a', action = 'store_true', help = 'flash all connected bootloaders in parallel')
+    parser.add_argument('-w', action = 'store_true', help = 'watch: flash every newly attached bootloader')
+    parser.add_argument('--fake', metavar = 'FLASH', action = 'append', help = 'use a simulated bootloader with flash content file FLASH (repeat for more devices)')
+    parser.add_argument('bin', help = 'firmware bin file')
+    args = parser.parse_args()
 
     try:
-        print('Connecting to device ...')
-        isp = Programmer()
-        isp.detect()
-        print('FOUND:', isp.chipname, 'with bootloader v' + isp.bootloader + '.')
-        print('Erasing chip ...')
-        isp.erase()
-        print('Flashing', sys.argv[1], 'to', isp.chipname, '...')
-        with open(sys.argv[1], 'rb') as f: data = f.read()
-        isp.flash_data(data)
-        print('SUCCESS:', len(data), 'bytes written.')
-        print('Verifying ...')
-        isp.verify_data(data)
-        print('SUCCESS:', len(data), 'bytes verified.')
-        isp.exit()
+        with open(args.bin, 'rb') as f: data = f.read()
+        if args.r and not args.fake:
+            print('Requesting bootloader from MacroPad ...')
+            count = request_bootloader(args.a or args.w)
+            wait_bootloader(count)
+        if args.w:
+            watch(data, args)
+        elif args.a or (args.fake and len(args.fake) > 1):
+            if not flash_all(data, args):
+                sys.exit(1)
+        else:
+            print('Connecting to device ...')
+            t = time.time()
+            isp = Programmer(FakeBootloader(args.fake[0]) if args.fake else None)
+            program(isp, data, args, print, t)
+    except KeyboardInterrupt:
+        pass
     except Exception as ex:
         if str(ex) != '':
             sys.stderr.write('ERROR: ' + str(ex) + '!\n')
@@ -77,25 +110,202 @@ def _main():
     print('DONE.')
     sys.exit(0)
 
+
+# Flash, verify and start one device, returns False if it was already up to date
+def program(isp, data, args, log, t):
+    isp.detect()
+    log('FOUND:', isp.chipname, 'with bootloader v' + isp.bootloader + '.', _took(t))
+    if args.d:
+        log('Comparing ...')
+        t = time.time()
+        blocks = isp.compare_data(data)
+        log(len(blocks), 'of', isp.block_count(data), 'blocks differ.', _took(t))
+        if not blocks:
+            log('SUCCESS: Firmware is up to date.')
+            isp.exit()
+            return False
+    log('Erasing chip ...')
+    t = time.time()
+    isp.erase()
+    log('SUCCESS: Chip erased.', _took(t))
+    log('Flashing', args.bin, 'to', isp.chipname, '...')
+    t = time.time()
+    isp.flash_data(data)
+    log('SUCCESS:', len(data), 'bytes written.', _took(t))
+    log('Verifying ...')
+    t = time.time()
+    isp.verify_data(data)
+    log('SUCCESS:', len(data), 'bytes verified.', _took(t))
+    isp.exit()
+    return True
+
+
+def _took(t):
+    return '(%.2f s)' % (time.time() - t)
+
+# ===================================================================================
+# Multiple Devices
+# ===================================================================================
+
+# Flash all connected bootloaders at once, one thread per device
+def flash_all(data, args):
+    if args.fake:
+        devices = [(name, FakeBootloader(name)) for name in args.fake]
+    else:
+        devices = [(device_name(dev), dev) for dev in find_bootloaders()]
+    if not devices:
+        raise Exception('No CH55x device found')
+    print('Flashing', len(devices), 'devices ...')
+    results = {}
+    workers = [start_worker(name, dev, data, args, results) for name, dev in devices]
+    for worker in workers:
+        worker.join()
+    return summary(results)
+
+
+# Flash every bootloader that shows up until interrupted with CTRL-C
+def watch(data, args):
+    find_bootloaders()                          # fails early without pyusb
+    print('Waiting for devices, press CTRL-C to stop ...')
+    results = {}
+    busy = {}
+    try:
+        while True:
+            present = set()
+            for dev in find_bootloaders():
+                name = device_name(dev)
+                present.add(name)
+                if name not in busy:            # newly attached
+                    busy[name] = start_worker(name, dev, data, args, results)
+            for name in list(busy):             # forget detached devices when done
+                if name not in present and not busy[name].is_alive():
+                    del busy[name]
+            time.sleep(WATCH_INTERVAL)
+    except KeyboardInterrupt:
+        for worker in busy.values():
+            worker.join()
+    print()
+    summary(results)
+
+
+def start_worker(name, dev, data, args, results):
+    key = name
+    count = 1
+    while key in results:                       # same port flashed again
+        count += 1
+        key = '%s #%d' % (name, count)
+    results[key] = 'busy'
+    worker = threading.Thread(target = flash_worker, args = (name, key, dev, data, args, results))
+    worker.start()
+    return worker
+
+
+def flash_worker(name, key, dev, data, args, results):
+    log = lambda *text: _print(name + ':', *text)
+    t = time.time()
+    try:
+        if isinstance(dev, FakeBootloader):
+            isp = Programmer(dev)
+        else:
+            isp = Programmer(dev = dev)
+        results[key] = 'flashed' if program(isp, data, args, log, t) else 'up to date'
+        log('DONE.', _took(t))
+    except Exception as ex:
+        results[key] = 'FAILED: ' + (str(ex) or 'error')
+        log('ERROR:', results[key][8:] + '!')
+
+
+def summary(results):
+    _print('Summary:')
+    for key in sorted(results):
+        _print('  ' + key + ':', results[key])
+    failed = sum(1 for r in results.values() if r.startswith('FAILED'))
+    _print(len(results), 'devices,', len(results) - failed, 'ok,', failed, 'failed.')
+    return failed == 0
+
+
+def find_bootloaders():
+    if usb is None:
+        raise Exception('pyusb is not installed')
+    return list(usb.core.find(find_all = True, idVendor = CH_VID, idProduct = CH_PID))
+
+
+def device_name(dev):
+    ports = getattr(dev, 'port_numbers', None)
+    if ports:
+        return 'bus %d port %s' % (dev.bus, '.'.join(str(p) for p in ports))
+    return 'bus %d address %d' % (dev.bus, dev.address)
+
+
+# Output lines of the worker threads must not mix
+_print_lock = threading.Lock()
+
+def _print(*text):
+    with _print_lock:
+        print(*text, flush = True)
+
+# ===================================================================================
+# Bootloader Request
+# ===================================================================================
+
+# Send the bootloader request to running MacroPad Plus firmwares (src/diag.h),
+# returns the number of devices
+def request_bootloader(all_devices = False):
+    import hid
+    paths = []
+    for d in hid.enumerate(MP_VID, MP_PID):
+        if d['usage_page'] == DIAG_USAGE_PAGE or (d['usage_page'] == 0 and d['interface_number'] == 0):
+            if d['path'] not in paths:
+                paths.append(d['path'])
+    if not paths:
+        raise Exception('No MacroPad found')
+    if not all_devices:
+        paths = paths[:1]
+    for path in paths:
+        dev = hid.device()
+        dev.open_path(path)
+        try:
+            dev.send_feature_report(bytes([DIAG_REPORT_BOOT]) + BOOT_MAGIC)
+        except (IOError, OSError):
+            pass                                # device may detach before the status stage
+        dev.close()
+    return len(paths)
+
+
+# Wait until the bootloaders have enumerated
+def wait_bootloader(count = 1):
+    deadline = time.time() + BOOT_TIMEOUT
+    while time.time() < deadline:
+        if len(find_bootloaders()) >= count:
+            time.sleep(0.2)                     # let the host finish enumeration
+            return
+        time.sleep(0.1)
+    raise Exception('Bootloader did not show up')
+
 # ===================================================================================
 # Programmer Class
 # ===================================================================================
 
 class Programmer:
-    def __init__(self):
-        dev = usb.core.find(idVendor = CH_VID, idProduct = CH_PID)
+    def __init__(self, backend = None, dev = None):
+        if backend is not None:
+            self.epout = self.epin = backend
+            self.__init_chip()
+            return
+
+        if usb is None:
+            raise Exception('pyusb is not installed')
+        if dev is None:
+            dev = usb.core.find(idVendor = CH_VID, idProduct = CH_PID)
         if dev is None:
-            sys.stderr.write('ERROR: No CH55x device found!\n')
-            print('Check if device is in boot mode or check driver.')
-            raise Exception()
+            raise Exception('No CH55x device found, check if device is in boot mode or check driver')
 
         try:
             dev.set_configuration()
         except usb.core.USBError as ex:
-            sys.stderr.write('ERROR: Could not access USB Device!\n')
             if str(ex).startswith('[Errno 13]') and platform.system() == 'Linux':
-                print('Configure udev or execute as root (sudo).')
-            raise Exception()
+                raise Exception('Could not access USB device, configure udev or execute as root (sudo)')
+            raise Exception('Could not access USB device')
 
         cfg = dev.get_active_configuration()
         intf = cfg[(0,0)]
@@ -104,7 +314,10 @@ class Programmer:
         self.epin = usb.util.find_descriptor(intf, custom_match = lambda e: usb.util.endpoint_direction(e.bEndpointAddress) == usb.util.ENDPOINT_IN)
         assert self.epout is not None
         assert self.epin is not None
+        self.__init_chip()
 
+
+    def __init_chip(self):
         self.chipid = 0
         self.chipname = 'CH000'
         self.bootloader = '0.0'
@@ -112,6 +325,7 @@ class Programmer:
         self.device_erase_size = 8
         self.device_flash_size = 16
         self.code_flash_size = 14336
+        self.packet_size = self.epout.wMaxPacketSize    # largest command packet
 
 
     def detect(self):
@@ -171,6 +385,25 @@ class Programmer:
         else:
             self.__writev2(data, MODE_VERIFY_V2)
 
+    # Addresses of the blocks whose flash content differs from data
+    def compare_data(self, data):
+        if len(data) > self.code_flash_size:
+            raise Exception('Not enough memory')
+        blocks = []
+        if self.chipversion == 1:
+            self.__writev1(data, MODE_VERIFY_V1, blocks)
+        else:
+            self.__writev2(data, MODE_VERIFY_V2, blocks)
+        return blocks
+
+    def block_count(self, data):
+        return -(-len(data) // self.__block_size())
+
+    def __block_size(self):
+        if self.chipversion == 1:
+            return self.packet_size - 4
+        return (self.packet_size - 8) & ~7
+
 
     def exit(self):
         if self.chipversion == 1:
@@ -228,7 +461,7 @@ class Programmer:
     def __erasev1(self):
         self.__sendcmd((0xa6, 0x04, 0x00, 0x00, 0x00, 0x00))
         for x in range(self.device_flash_size):
-            buffer = __sendcmd((0xa9, 0x02, 0x00, x * 4))
+            buffer = self.__sendcmd((0xa9, 0x02, 0x00, x * 4))
             if buffer[0] != 0x00:
                 raise Exception('Erase failed')
 
@@ -245,15 +478,17 @@ class Programmer:
         self.epout.write((0xa2, 0x01, 0x00, 0x01))
 
 
-    def __writev1(self, data, mode):
+    # Write or verify data, differing blocks are collected in diff instead of failing
+    def __writev1(self, data, mode, diff = None):
         rest = len(data)
         curr_addr = 0
         pkt_length = 0
-        outbuffer = bytearray(64)
+        block_size = self.__block_size()
+        outbuffer = bytearray(self.packet_size)
         outbuffer[0] = mode
         while curr_addr < len(data):
-            if rest >= 0x3c:
-                pkt_length = 0x3c
+            if rest >= block_size:
+                pkt_length = block_size
             else:
                 pkt_length = rest
             outbuffer[1] = pkt_length
@@ -266,24 +501,27 @@ class Programmer:
             rest -= pkt_length
             if buffer is not None:
                 if buffer[0] != 0x00:
-                    if mode == MODE_WRITE_V1:
+                    if diff is not None:
+                        diff.append(curr_addr - pkt_length)
+                    elif mode == MODE_WRITE_V1:
                         raise Exception('Write failed')
                     elif mode == MODE_VERIFY_V1:
                         raise Exception('Verify failed')
         return len(data)
 
-    def __writev2(self, data, mode):
+    def __writev2(self, data, mode, diff = None):
         rest = len(data)
         curr_addr = 0
         pkt_length = 0
-        outbuffer = bytearray(64)
+        block_size = self.__block_size()
+        outbuffer = bytearray(self.packet_size)
         outbuffer[0] = mode
         outbuffer[2] = 0x00
         outbuffer[5] = 0x00
         outbuffer[6] = 0x00
         while curr_addr < len(data):
-            if rest >= 0x38:
-                pkt_length = 0x38
+            if rest >= block_size:
+                pkt_length = block_size
             else:
                 pkt_length = rest
             outbuffer[1] = (pkt_length+5)
@@ -300,12 +538,74 @@ class Programmer:
             rest -= pkt_length
             if buffer is not None:
                 if buffer[4] != 0x00 and buffer[4] != 0xfe and buffer[4] != 0xf5:
-                    if mode == MODE_WRITE_V2:
+                    if diff is not None:
+                        diff.append(curr_addr - pkt_length)
+                    elif mode == MODE_WRITE_V2:
                         raise Exception('Write failed')
                     elif mode == MODE_VERIFY_V2:
                         raise Exception('Verify failed')
 
 
+# ===================================================================================
+# Fake Bootloader Class
+# ===================================================================================
+
+# CH552 with bootloader v2.5 in software, takes the place of the USB endpoints of
+# the programmer. Like real flash, programming can only clear bits, so writing
+# without erasing first fails the verification.
+class FakeBootloader:
+    wMaxPacketSize = 64
+
+    def __init__(self, filename):
+        self.filename = filename
+        self.flash = bytearray(b'\xff' * FAKE_FLASH_SIZE)
+        if os.path.exists(filename):
+            with open(filename, 'rb') as f: content = f.read(FAKE_FLASH_SIZE)
+            self.flash[:len(content)] = content
+        self.answer = b''
+
+
+    def write(self, cmd):
+        cmd = bytes(cmd)
+        if cmd[0] == 0xa1:                      # detect chip
+            self.answer = bytes((0xa1, 0x00, 0x02, 0x00, FAKE_CHIP_ID, 0x11))
+        elif cmd[0] == 0xa7:                    # read configuration
+            cfg = bytearray(30)
+            cfg[0] = 0xa7
+            cfg[19:22] = (2, 5, 0)
+            cfg[22:26] = FAKE_UID
+            self.answer = bytes(cfg)
+        elif cmd[0] == 0xa3:                    # set key
+            self.answer = self.__status(cmd, 0x00)
+        elif cmd[0] == 0xa4:                    # erase whole code flash
+            self.flash[:] = b'\xff' * FAKE_FLASH_SIZE
+            self.answer = self.__status(cmd, 0x00)
+        elif cmd[0] == MODE_WRITE_V2 or cmd[0] == MODE_VERIFY_V2:
+            length = cmd[1] - 5
+            addr = cmd[3] | (cmd[4] << 8)
+            data = bytes(b ^ FAKE_CHIP_ID if x % 8 == 7 else b for x, b in enumerate(cmd[:length + 8]))[8:]
+            if addr + length > FAKE_FLASH_SIZE:
+                self.answer = self.__status(cmd, 0x01)
+            elif cmd[0] == MODE_WRITE_V2:
+                for x in range(length):
+                    self.flash[addr + x] &= data[x]
+                self.answer = self.__status(cmd, 0x00)
+            else:
+                self.answer = self.__status(cmd, 0x00 if self.flash[addr:addr + length] == data else 0x01)
+        elif cmd[0] == 0xa2:                    # exit bootloader, no answer
+            with open(self.filename, 'wb') as f: f.write(self.flash)
+            self.answer = b''
+        else:
+            self.answer = self.__status(cmd, 0xff)
+
+
+    def read(self, size):
+        return self.answer[:size]
+
+
+    def __status(self, cmd, status):
+        return bytes((cmd[0], 0x00, 0x02, 0x00, status, 0x00))
+
 # ===================================================================================
 # CH55x Protocol Constants
 # ===================================================================================
@@ -321,6 +621,26 @@ MODE_VERIFY_V2 = 0xa6
 DETECT_CHIP_CMD_V1 = (0xa2, 0x13, 0x55, 0x53, 0x42, 0x20, 0x44, 0x42, 0x47, 0x20, 0x43, 0x48, 0x35, 0x35, 0x39, 0x20, 0x26, 0x20, 0x49, 0x53, 0x50, 0x00)
 DETECT_CHIP_CMD_V2 = (0xa1, 0x12, 0x00, 0x52, 0x11, 0x4d, 0x43, 0x55, 0x20, 0x49, 0x53, 0x50, 0x20, 0x26, 0x20, 0x57, 0x43, 0x48, 0x2e, 0x43, 0x4e)
 
+# ===================================================================================
+# MacroPad Plus Constants
+# ===================================================================================
+
+MP_VID           = 0x04b1
+MP_PID           = 0x4657
+DIAG_USAGE_PAGE  = 0xff00
+DIAG_REPORT_BOOT = 0x15
+BOOT_MAGIC       = b'BOOT'
+BOOT_TIMEOUT     = 10                   # seconds until the bootloader has to appear
+WATCH_INTERVAL   = 0.5                  # seconds between bus scans in watch mode
+
+# ===================================================================================
+# Fake Bootloader Constants
+# ===================================================================================
+
+FAKE_CHIP_ID     = 0x52                 # CH552
+FAKE_FLASH_SIZE  = 14336
+FAKE_UID         = (0x12, 0x34, 0x56, 0x78)
+
 # ===================================================================================
 
 if __name__ == "__main__":
@@ -0,0 +1,160 @@
+#!/usr/bin/env python3
+# ===================================================================================
+# Project:   diag - Read Diagnostics from the MacroPad Plus
+# Version:   v1.0
+# Year:      2023
+# License:   MIT License
+# ===================================================================================
+#
+# Description:
+# ------------
+# Reads the diagnostic feature reports of the vendor-defined HID collection of the
+# MacroPad Plus firmware (see src/diag.h) and prints them.
+#
+# Dependencies:
+# -------------
+# - hidapi (python bindings)
+#
+# Operating Instructions:
+# -----------------------
+# You need to install hidapi to use diag. Install it via "pip install hidapi".
+#
+# Linux users need permission to access the hidraw device. Run:
+# echo 'KERNEL=="hidraw*", ATTRS{idVendor}=="04b1", ATTRS{idProduct}=="4657", MODE="666"' | sudo tee /etc/udev/rules.d/99-macropad.rules
+# Restart udev: sudo service udev restart
+#
+# Connect the MacroPad via USB to your PC and run "python3 diag.py".
+
+
+import hid
+import sys, struct
+
+
+# ===================================================================================
+# Main Function
+# ===================================================================================
+
+def _main():
+    try:
+        dev = Diag()
+        dev.print_cal()
+        dev.print_latency()
+        dev.print_profile()
+        dev.print_telemetry()
+    except Exception as ex:
+        if str(ex) != '':
+            sys.stderr.write('ERROR: ' + str(ex) + '!\n')
+        sys.exit(1)
+    sys.exit(0)
+
+# ===================================================================================
+# Diagnostics Class
+# ===================================================================================
+
+class Diag:
+    def __init__(self):
+        path = None
+        for d in hid.enumerate(MP_VID, MP_PID):
+            if d['usage_page'] == DIAG_USAGE_PAGE or (d['usage_page'] == 0 and d['interface_number'] == 0):
+                path = d['path']
+                break
+        if path is None:
+            raise Exception('No MacroPad found')
+        self.dev = hid.device()
+        self.dev.open_path(path)
+
+
+    def get_feature(self, report_id, length):
+        data = bytes(self.dev.get_feature_report(report_id, length + 1))
+        if len(data) < length + 1 or data[0] != report_id:
+            raise Exception('Failed to read report 0x%02x' % report_id)
+        return data[1:length + 1]
+
+
+    def print_cal(self):
+        error, cycles, clock, count = struct.unpack('<hHBH', self.get_feature(REPORT_CAL, 7))
+        print('Oscillator calibration:')
+        if clock == 0xff:
+            print('  not measured yet')
+            return
+        print('  system clock:    %s' % CLK_NAMES[clock & 7])
+        print('  cycles per ms:   %d' % cycles)
+        print('  deviation:       %+d ppm (%+.3f %%)' % (error, error / 10000))
+        print('  DLY_us() per ms: %d' % count)
+
+
+    def print_latency(self):
+        data = struct.unpack('<%dH' % (LAT_BUCKETS + 2), self.get_feature(REPORT_LAT, 2 * LAT_BUCKETS + 4))
+        hist, longest, last = data[:LAT_BUCKETS], data[LAT_BUCKETS], data[LAT_BUCKETS + 1]
+        print('Input-to-report latency:')
+        if not sum(hist):
+            print('  no measurements yet')
+            return
+        for i, count in enumerate(hist):
+            if not count:
+                continue
+            low  = 0 if i == 0 else 1 << (i - 1)
+            high = '...' if i == LAT_BUCKETS - 1 else '%6d us' % ((1 << i) - 1 if i else 0)
+            print('  %6d .. %9s: %5d %s' % (low, high, count, '#' * min(count * 40 // max(hist), 40)))
+        print('  longest:         %d us' % longest)
+        print('  latest:          %d us' % last)
+
+
+    def print_profile(self):
+        print('Section profiler (system clock cycles):')
+        try:
+            data = self.get_feature(REPORT_PROF, 12 * len(PROF_SECTIONS))
+        except Exception:
+            print('  not available (enable PROF_ENABLE in src/config.h)')
+            return
+        print('  %-10s %10s %8s %8s %8s' % ('section', 'runs', 'min', 'avg', 'max'))
+        for i, name in enumerate(PROF_SECTIONS):
+            count, total, low, high = struct.unpack_from('<IIHH', data, 12 * i)
+            if count:
+                print('  %-10s %10d %8d %8d %8d' % (name, count, low, total // count, high))
+            else:
+                print('  %-10s %10d %8s %8s %8s' % (name, 0, '-', '-', '-'))
+
+
+    def print_telemetry(self):
+        data = struct.unpack('<B7HIH', self.get_feature(REPORT_TELE, 21))
+        print('USB transport telemetry:')
+        print('  last reset:      %s' % RST_NAMES[data[0] & 3])
+        print('  starts:          %d (since power-on)' % data[1])
+        print('  watchdog resets: %d' % data[2])
+        print('  soft resets:     %d' % data[3])
+        print('  bus resets:      %d' % data[4])
+        print('  suspends:        %d' % data[5])
+        print('  stalled SETUPs:  %d' % data[6])
+        print('  dropped reports: %d' % data[7])
+        print('  EP1 busy spins:  %d' % data[8])
+        print('  coalesced:       %d' % data[9])
+
+
+# ===================================================================================
+# Device Constants
+# ===================================================================================
+
+MP_VID           = 0x04b1
+MP_PID           = 0x4657
+DIAG_USAGE_PAGE  = 0xff00
+
+REPORT_CAL       = 0x10
+REPORT_LAT       = 0x11
+
+LAT_BUCKETS      = 16
+
+REPORT_PROF      = 0x12
+PROF_SECTIONS    = ('USB ISR', 'EP0 SETUP', 'EP0 IN', 'SOF', 'EP1 IN', 'EP2 OUT',
+                    'debounce', 'macro', 'NeoPixel', 'report')
+
+REPORT_TELE      = 0x14
+RST_NAMES        = ('power-on', 'software', 'watchdog', 'RST pin')
+
+CLK_NAMES        = ('187.5 kHz', '750 kHz', '3 MHz', '6 MHz',
+                    '12 MHz', '16 MHz', '24 MHz', '32 MHz')
+
+# ===================================================================================
+
+if __name__ == "__main__":
+    _main()
@@ -0,0 +1,156 @@
+#!/usr/bin/env python3
+# ===================================================================================
+# Project:   rawhid - Talk to the Raw HID Interface of the MacroPad Plus
+# Version:   v1.0
+# Year:      2023
+# License:   MIT License
+# ===================================================================================
+#
+# Description:
+# ------------
+# Example host application for the raw HID interface of the MacroPad Plus firmware
+# (see src/raw.h and RAW_CMD_xxx in macropad_plus.c). Sets the colors of the
+# NeoPixels or prints the state packets (inputs, encoder position) which the
+# MacroPad sends on every input change.
+#
+# Dependencies:
+# -------------
+# - hidapi (python bindings) for the raw HID interface
+# - PyUSB for the vendor interface (RAW_WINUSB)
+#
+# Operating Instructions:
+# -----------------------
+# The firmware has to be compiled with RAW_ENABLE (see src/config.h). Linux users
+# need permission to access the hidraw device (see diag.py) or, with RAW_WINUSB,
+# the USB device (same rule with SUBSYSTEM=="usb" instead of KERNEL=="hidraw*").
+#
+# python3 rawhid.py leds ff0000 00ff00 0000ff   set NeoPixel colors (RGB hex)
+# python3 rawhid.py state                       print current state
+# python3 rawhid.py watch                       print state on every input change
+
+
+import sys, struct
+
+
+# ===================================================================================
+# Main Function
+# ===================================================================================
+
+def _main():
+    args = sys.argv[1:]
+    if not args or args[0] not in ('leds', 'state', 'watch'):
+        sys.stderr.write('Usage: rawhid.py leds RRGGBB... | state | watch\n')
+        sys.exit(1)
+    try:
+        dev = open_device()
+        if args[0] == 'leds':
+            dev.set_leds([bytes.fromhex(c) for c in args[1:]])
+        elif args[0] == 'state':
+            dev.write(bytes([RAW_CMD_STATE]))
+            print_state(dev.read_state())
+        else:
+            while True:
+                print_state(dev.read_state())
+    except KeyboardInterrupt:
+        pass
+    except Exception as ex:
+        if str(ex) != '':
+            sys.stderr.write('ERROR: ' + str(ex) + '!\n')
+        sys.exit(1)
+    sys.exit(0)
+
+# ===================================================================================
+# Raw HID and Vendor Interface Classes
+# ===================================================================================
+
+def open_device():
+    try:
+        return RawHID()
+    except Exception:
+        return RawUSB()
+
+
+class RawHID:
+    def __init__(self):
+        import hid
+        path = None
+        for d in hid.enumerate(MP_VID, MP_PID):
+            if d['usage_page'] == RAW_USAGE_PAGE or d['interface_number'] == RAW_INTERFACE:
+                path = d['path']
+                break
+        if path is None:
+            raise Exception('No MacroPad with raw HID interface found')
+        self.dev = hid.device()
+        self.dev.open_path(path)
+
+
+    # Packets are always 64 bytes, hidapi needs report ID 0 in front
+    def write(self, data):
+        if self.dev.write(b'\x00' + data + bytes(RAW_SIZE - len(data))) < 0:
+            raise Exception('Failed to send packet')
+
+
+    def read_state(self):
+        while True:
+            data = bytes(self.dev.read(RAW_SIZE))
+            if data and data[0] == RAW_CMD_STATE:
+                return struct.unpack_from('<BhH', data, 1)
+
+
+    def set_leds(self, colors):
+        if len(colors) > NEO_COUNT or any(len(c) != 3 for c in colors):
+            raise Exception('Up to %d colors RRGGBB expected' % NEO_COUNT)
+        self.write(bytes([RAW_CMD_LEDS]) + b''.join(colors))
+
+
+# Same packets on the bulk endpoints of the vendor interface (RAW_WINUSB)
+class RawUSB(RawHID):
+    def __init__(self):
+        import usb.core, usb.util
+        self.dev = usb.core.find(idVendor = MP_VID, idProduct = MP_PID)
+        if self.dev is None:
+            raise Exception('No MacroPad with raw interface found')
+        intf = self.dev.get_active_configuration()[(RAW_INTERFACE, 0)]
+        if intf.bInterfaceClass != 0xff:
+            raise Exception('No MacroPad with raw interface found')
+        usb.util.claim_interface(self.dev, RAW_INTERFACE)
+
+
+    def write(self, data):
+        self.dev.write(RAW_EP_OUT, data + bytes(RAW_SIZE - len(data)))
+
+
+    def read_state(self):
+        while True:
+            data = bytes(self.dev.read(RAW_EP_IN, RAW_SIZE, timeout = 0))
+            if data and data[0] == RAW_CMD_STATE:
+                return struct.unpack_from('<BhH', data, 1)
+
+
+def print_state(state):
+    inputs, position, ms = state
+    names = ' '.join(n for i, n in enumerate(IN_NAMES) if inputs & (1 << i))
+    print('%5d ms  encoder %+5d  %s' % (ms, position, names or '-'))
+
+# ===================================================================================
+# Device Constants
+# ===================================================================================
+
+MP_VID           = 0x04b1
+MP_PID           = 0x4657
+RAW_USAGE_PAGE   = 0xff60
+RAW_INTERFACE    = 1
+RAW_SIZE         = 64
+RAW_EP_IN        = 0x84
+RAW_EP_OUT       = 0x04
+
+RAW_CMD_LEDS     = 0x01
+RAW_CMD_STATE    = 0x02
+
+NEO_COUNT        = 3
+IN_NAMES         = ('KEY1', 'KEY2', 'KEY3', 'ENC_A', 'ENC_SW')
+
+# ===================================================================================
+
+if __name__ == "__main__":
+    _main()
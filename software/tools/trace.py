@@ -0,0 +1,156 @@
+#!/usr/bin/env python3
+# ===================================================================================
+# Project:   trace - Read the Input Event Trace from the MacroPad Plus
+# Version:   v1.0
+# Year:      2023
+# License:   MIT License
+# ===================================================================================
+#
+# Description:
+# ------------
+# Freezes the input event trace of the MacroPad Plus firmware (see src/trace.h),
+# reads the ring buffer in chunks and prints the recorded raw pin transitions,
+# debounce decisions, encoder steps and sent HID reports as a timeline. The trace
+# is cleared and restarted afterwards.
+#
+# Dependencies:
+# -------------
+# - hidapi (python bindings)
+# - diag.py (same directory)
+#
+# Operating Instructions:
+# -----------------------
+# The firmware has to be compiled with TRACE_ENABLE (see src/config.h). Reproduce
+# the problem (e.g. a skipped encoder step) and run "python3 trace.py" right
+# afterwards. With "-k" the trace stays frozen and is not cleared.
+
+
+import sys, struct
+from diag import Diag
+
+
+# ===================================================================================
+# Main Function
+# ===================================================================================
+
+def _main():
+    keep = '-k' in sys.argv[1:]
+    try:
+        dev = Diag()
+        entries = read_trace(dev)
+        if not keep:
+            set_command(dev, TRACE_CMD_RUN)
+    except Exception as ex:
+        if str(ex) != '':
+            sys.stderr.write('ERROR: ' + str(ex) + '!\n')
+        sys.exit(1)
+    print_timeline(entries)
+    sys.exit(0)
+
+# ===================================================================================
+# Device Access
+# ===================================================================================
+
+def set_command(dev, cmd):
+    report = bytes([REPORT_TRACE, cmd]) + bytes(TRACE_REPORT_LEN - 1)
+    if dev.dev.send_feature_report(report) < 0:
+        raise Exception('Failed to send trace command')
+
+
+# Freeze the ring, read all chunks and return the entries from oldest to newest
+def read_trace(dev):
+    set_command(dev, TRACE_CMD_FREEZE)
+    data = dev.get_feature(REPORT_TRACE, TRACE_REPORT_LEN)
+    flags, size, head, index = struct.unpack_from('<BBBB', data)
+    if not flags & 1:
+        raise Exception('Trace not frozen')
+    chunks = {index: data[4:]}
+    while len(chunks) < size // TRACE_CHUNK:
+        data = dev.get_feature(REPORT_TRACE, TRACE_REPORT_LEN)
+        chunks[data[3]] = data[4:]
+    ring = b''.join(chunks[i] for i in range(size // TRACE_CHUNK))
+    entries = [struct.unpack_from('<HBB', ring, 4 * i) for i in range(size)]
+    if flags & 2:
+        entries = entries[head:] + entries[:head]     # ring was filled: oldest at head
+    else:
+        entries = entries[:head]
+    return [e for e in entries if e[1] != TRACE_EMPTY]
+
+# ===================================================================================
+# Timeline Output
+# ===================================================================================
+
+def print_timeline(entries):
+    print('Input event trace (%d entries):' % len(entries))
+    if not entries:
+        print('  no events recorded')
+        return
+    print('  %8s %7s  %-8s %s' % ('time', 'delta', 'event', 'details'))
+    start = prev = entries[0][0]
+    time  = 0
+    raw   = 0
+    for ms, etype, data in entries:
+        delta = (ms - prev) & 0xffff                  # 16-bit timestamps wrap around
+        time += delta
+        prev  = ms
+        if etype == TRACE_PIN:
+            event, details = 'pins', _inputs(data) or '-'
+            raw = data
+        elif etype == TRACE_ACCEPT:
+            event = 'accept'
+            details = ', '.join('%s %s' % (n, 'down' if raw & (1 << i) else 'up')
+                                for i, n in enumerate(IN_NAMES) if data & (1 << i))
+        elif etype == TRACE_REJECT:
+            event, details = 'reject', _inputs(data) + ' (bouncing)'
+        elif etype == TRACE_ENC:
+            event, details = 'encoder', {TRACE_CW: 'clockwise', TRACE_CCW: 'counter-clockwise'}.get(data, '?')
+        elif etype & TRACE_REPORT:
+            event, details = 'report', _report(etype & 0x7f, data)
+        else:
+            event, details = '0x%02x' % etype, '0x%02x' % data
+        print('  %8d %7s  %-8s %s' % (time, '+%d' % delta if delta else '', event, details))
+    print('  (time in ms since the first entry at tick %d)' % start)
+
+
+def _inputs(mask):
+    return ' '.join(n for i, n in enumerate(IN_NAMES) if mask & (1 << i))
+
+
+def _report(report_id, data):
+    if report_id == 1:
+        if not data:
+            return 'keyboard: no key'
+        if 0x68 <= data <= 0x73:
+            return 'keyboard: F%d' % (data - 0x68 + 13)
+        return 'keyboard: key 0x%02x' % data
+    if report_id == 2:
+        return 'consumer: usage 0x..%02x' % data if data else 'consumer: no key'
+    return 'ID %d: 0x%02x' % (report_id, data)
+
+# ===================================================================================
+# Device Constants
+# ===================================================================================
+
+REPORT_TRACE     = 0x13
+TRACE_REPORT_LEN = 4 + 64                             # header + one chunk
+TRACE_CHUNK      = 16                                 # entries per chunk
+
+TRACE_CMD_RUN    = 0x00
+TRACE_CMD_FREEZE = 0x01
+
+TRACE_EMPTY      = 0x00
+TRACE_PIN        = 0x01
+TRACE_ACCEPT     = 0x02
+TRACE_REJECT     = 0x03
+TRACE_ENC        = 0x04
+TRACE_REPORT     = 0x80
+
+TRACE_CW         = 0x01
+TRACE_CCW        = 0x02
+
+IN_NAMES         = ('KEY1', 'KEY2', 'KEY3', 'ENC_A', 'ENC_SW')
+
+# ===================================================================================
+
+if __name__ == "__main__":
+    _main()